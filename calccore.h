@@ -0,0 +1,972 @@
+#pragma once
+
+#include "displaytext.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+
+// the calculator's rules for editing and calculating display values, written
+// as constexpr functions so they can also run at compile time, through the
+// keystroke evaluator at the bottom
+// constant evaluation relies on GCC treating the cmath functions as constexpr
+// the number conversions and the overflowing ops take a separate exact path
+// when constant evaluated, tests/coretest checks both paths agree
+// compile time math is correctly rounded, while the runtime library's can be
+// an ulp off for pow and log, which only shows in results within an ulp of a
+// display rounding boundary
+
+// the significant digits a display shows, numbers are rounded to this
+constexpr int DISPLAY_PRECISION = 10;
+// the digits an exponent can be typed with
+constexpr int EXPONENT_PRECISION = 3;
+
+//------------------------------constants----------------------------
+
+constexpr double LOG10_2 = 0.30102999566398119521;
+// every power of ten a double holds exactly
+constexpr double EXACT_POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+constexpr int MAX_EXACT_POW10 = 22;
+
+//------------------------------big integers-------------------------
+
+// an unsigned integer big enough to hold any double, or any displayed
+// decimal, exactly as a fraction of two of them
+// only used to convert numbers at compile time, at runtime std::to_chars
+// and std::from_chars do the same exact conversions faster
+class BigInt {
+public:
+	static constexpr int WORDS = 96;
+
+	constexpr BigInt(const uint64_t value = 0) {
+		words[0] = uint32_t(value);
+		words[1] = uint32_t(value >> 32);
+		size = (words[1] != 0) ? 2 : (words[0] != 0) ? 1 : 0;
+	}
+
+	constexpr bool is_zero() const {
+		return size == 0;
+	}
+	constexpr int bit_length() const {
+		if (size == 0)
+			return 0;
+		int bits = 32 * (size - 1);
+		for (uint32_t top = words[size - 1]; top != 0; top >>= 1)
+			++bits;
+		return bits;
+	}
+	// returns -1, 0 or 1 as this is less than, equal to or more than other
+	constexpr int compare(const BigInt &other) const {
+		if (size != other.size)
+			return (size < other.size) ? -1 : 1;
+		for (int i = size - 1; i >= 0; --i) {
+			if (words[i] != other.words[i])
+				return (words[i] < other.words[i]) ? -1 : 1;
+		}
+		return 0;
+	}
+
+	constexpr void multiply_add(const uint32_t factor, const uint32_t addend) {
+		uint64_t carry = addend;
+		for (int i = 0; i < size; ++i) {
+			uint64_t product = uint64_t(words[i]) * factor + carry;
+			words[i] = uint32_t(product);
+			carry = product >> 32;
+		}
+		if (carry != 0)
+			words[size++] = uint32_t(carry);
+	}
+	constexpr void multiply_pow10(int power) {
+		for (; power >= 9; power -= 9)
+			multiply_add(1000000000, 0);
+		multiply_add(uint32_t(EXACT_POW10[power]), 0);
+	}
+	constexpr void shift_left(const int bits) {
+		if (size == 0)
+			return;
+		const int word_shift = bits / 32;
+		const int bit_shift = bits % 32;
+		words[size + word_shift] = 0;
+		for (int i = size - 1; i >= 0; --i) {
+			uint64_t shifted = uint64_t(words[i]) << bit_shift;
+			words[i + word_shift + 1] |= uint32_t(shifted >> 32);
+			words[i + word_shift] = uint32_t(shifted);
+		}
+		for (int i = 0; i < word_shift; ++i)
+			words[i] = 0;
+		size += word_shift + 1;
+		trim();
+	}
+	// requires other <= this
+	constexpr void subtract(const BigInt &other) {
+		int64_t borrow = 0;
+		for (int i = 0; i < size; ++i) {
+			int64_t difference = int64_t(words[i]) - borrow
+								 - ((i < other.size) ? other.words[i] : 0);
+			borrow = (difference < 0) ? 1 : 0;
+			words[i] = uint32_t(difference + (borrow << 32));
+		}
+		trim();
+	}
+	// replaces this with the remainder and returns the quotient,
+	// which must be less than 2^(max_bits + 1)
+	constexpr uint64_t divide(const BigInt &divisor, const int max_bits) {
+		uint64_t quotient = 0;
+		for (int bit = max_bits; bit >= 0; --bit) {
+			BigInt shifted = divisor;
+			shifted.shift_left(bit);
+			if (compare(shifted) >= 0) {
+				subtract(shifted);
+				quotient |= uint64_t(1) << bit;
+			}
+		}
+		return quotient;
+	}
+
+private:
+	// least significant first, only the first size are in use
+	uint32_t words[WORDS] = {};
+	int size = 0;
+
+	constexpr void trim() {
+		while (size > 0 && words[size - 1] == 0)
+			--size;
+	}
+};
+
+//--------------------------number conversion------------------------
+
+// rounds value exactly to DISPLAY_PRECISION significant digits, half to
+// even like std::to_chars, giving digits * 10^exponent
+// value must be finite and more than 0
+constexpr void exact_digits(const double value, long long &digits,
+							int &exponent) {
+	// value = mantissa * 2^(frexp_exp - 53) exactly
+	int frexp_exp = 0;
+	const double fraction = std::frexp(value, &frexp_exp);
+	const int binary_exp = frexp_exp - 53;
+	BigInt numerator(uint64_t(std::ldexp(fraction, 53)));
+	BigInt denominator(1);
+	if (binary_exp >= 0)
+		numerator.shift_left(binary_exp);
+	else
+		denominator.shift_left(-binary_exp);
+
+	const long long min_digits = EXACT_POW10[DISPLAY_PRECISION - 1];
+	const long long max_digits = EXACT_POW10[DISPLAY_PRECISION];
+	// the decimal exponent of the leading digit, the estimate may be one low
+	int lead = std::floor((frexp_exp - 1) * LOG10_2);
+	while (true) {
+		BigInt remainder = numerator;
+		BigInt divisor = denominator;
+		const int scale = DISPLAY_PRECISION - 1 - lead;
+		if (scale >= 0)
+			remainder.multiply_pow10(scale);
+		else
+			divisor.multiply_pow10(-scale);
+		long long quotient = remainder.divide(divisor, 40);
+		if (quotient >= max_digits) {
+			++lead;
+			continue;
+		}
+		if (quotient < min_digits) {
+			--lead;
+			continue;
+		}
+		remainder.shift_left(1);
+		const int half = remainder.compare(divisor);
+		if (half > 0 || (half == 0 && quotient % 2 == 1))
+			++quotient;
+		if (quotient == max_digits) {
+			quotient = min_digits;
+			++lead;
+		}
+		digits = quotient;
+		exponent = lead - (DISPLAY_PRECISION - 1);
+		return;
+	}
+}
+
+// splits value rounded to DISPLAY_PRECISION significant digits into
+// digits * 10^exponent, with trailing zeros removed from digits
+// value must be finite
+constexpr void display_digits(const double value, long long &digits,
+							  int &exponent) {
+	digits = 0;
+	exponent = 0;
+	if (value == 0)
+		return;
+	if (__builtin_is_constant_evaluated()) {
+		exact_digits(std::fabs(value), digits, exponent);
+	} else {
+		char buffer[32] = {};
+		const char *end = std::to_chars(buffer, buffer + sizeof(buffer),
+										std::fabs(value),
+										std::chars_format::scientific,
+										DISPLAY_PRECISION - 1).ptr;
+		// d.ddddddddde-dd
+		const char *c = buffer;
+		int length = 0;
+		for (; *c != 'e'; ++c) {
+			if (*c == '.')
+				continue;
+			digits = digits * 10 + (*c - '0');
+			++length;
+		}
+		// from_chars doesn't take a plus sign
+		++c;
+		if (*c == '+')
+			++c;
+		std::from_chars(c, end, exponent);
+		exponent -= length - 1;
+	}
+	while (digits % 10 == 0) {
+		digits /= 10;
+		++exponent;
+	}
+	if (value < 0)
+		digits = -digits;
+}
+
+// formats like QString::setNum(value, 'g', DISPLAY_PRECISION)
+// the locale is ignored, just like QString
+constexpr DisplayText format_number(const double value) {
+	if (std::isnan(value))
+		return DisplayText(u"nan");
+	if (!__builtin_is_constant_evaluated()) {
+		char buffer[DisplayText::MAX_LENGTH] = {};
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+									std::chars_format::general,
+									DISPLAY_PRECISION);
+		DisplayText text;
+		for (const char *c = buffer; c != result.ptr; ++c)
+			text.append(*c);
+		return text;
+	}
+
+	DisplayText text;
+	if (std::signbit(value))
+		text.append(u'-');
+	if (std::isinf(value)) {
+		text.append(u'i');
+		text.append(u'n');
+		text.append(u'f');
+		return text;
+	}
+	if (value == 0) {
+		text.append(u'0');
+		return text;
+	}
+	long long digits = 0;
+	int exponent = 0;
+	display_digits(std::fabs(value), digits, exponent);
+	char16_t chars[DISPLAY_PRECISION] = {};
+	int count = 0;
+	for (long long rest = digits; rest != 0; rest /= 10)
+		++count;
+	for (int i = count - 1; i >= 0; --i) {
+		chars[i] = u'0' + digits % 10;
+		digits /= 10;
+	}
+	// the decimal exponent of the leading digit, as printf %g uses it
+	const int lead = exponent + count - 1;
+	if (lead < -4 || lead >= DISPLAY_PRECISION) {
+		text.append(chars[0]);
+		if (count > 1) {
+			text.append(u'.');
+			for (int i = 1; i < count; ++i)
+				text.append(chars[i]);
+		}
+		text.append(u'e');
+		text.append((lead < 0) ? u'-' : u'+');
+		int power = (lead < 0) ? -lead : lead;
+		if (power >= 100)
+			text.append(u'0' + power / 100);
+		text.append(u'0' + power / 10 % 10);
+		text.append(u'0' + power % 10);
+	} else if (lead >= 0) {
+		for (int i = 0; i <= lead; ++i)
+			text.append((i < count) ? chars[i] : u'0');
+		if (count > lead + 1) {
+			text.append(u'.');
+			for (int i = lead + 1; i < count; ++i)
+				text.append(chars[i]);
+		}
+	} else {
+		text.append(u'0');
+		text.append(u'.');
+		for (int i = lead + 1; i < 0; ++i)
+			text.append(u'0');
+		for (int i = 0; i < count; ++i)
+			text.append(chars[i]);
+	}
+	return text;
+}
+
+// returns the double nearest mantissa * 10^exponent, rounding half to even
+// returns 0 when that is out of range, like std::from_chars leaves it
+constexpr double exact_decimal_to_double(BigInt mantissa, const int exponent,
+										 const bool negative) {
+	if (mantissa.is_zero())
+		return negative ? -0.0 : 0.0;
+	// beyond these the result is inf or 0 for any displayable mantissa
+	if (exponent > 400 || exponent < -400)
+		return 0;
+	BigInt divisor(1);
+	if (exponent >= 0)
+		mantissa.multiply_pow10(exponent);
+	else
+		divisor.multiply_pow10(-exponent);
+	// scale so the quotient has 55 or 56 bits, two more than a double holds
+	const int shift = mantissa.bit_length() - divisor.bit_length() - 55;
+	if (shift >= 0)
+		divisor.shift_left(shift);
+	else
+		mantissa.shift_left(-shift);
+	const uint64_t quotient = mantissa.divide(divisor, 57);
+	const bool sticky = !mantissa.is_zero();
+
+	int length = 0;
+	for (uint64_t rest = quotient; rest != 0; rest >>= 1)
+		++length;
+	// drop the bits a double can't hold, more for subnormals
+	const int drop = std::max(length - 53, -1074 - shift);
+	if (drop >= 60)
+		return 0;
+	uint64_t kept = quotient >> drop;
+	const uint64_t rest = quotient & ((uint64_t(1) << drop) - 1);
+	const uint64_t half = uint64_t(1) << (drop - 1);
+	if (rest > half || (rest == half && (sticky || kept % 2 == 1)))
+		++kept;
+	if (kept == 0)
+		return 0;
+	// an overflowing ldexp isn't a constant, so check the range first
+	int kept_length = 0;
+	for (uint64_t rest = kept; rest != 0; rest >>= 1)
+		++kept_length;
+	if (kept_length + shift + drop > 1024)
+		return 0;
+	const double result = std::ldexp(double(kept), shift + drop);
+	return negative ? -result : result;
+}
+
+// reads the longest number at the start of str, so "1e+" reads as 1
+// returns 0 if str doesn't start with a number or it is out of range
+// the same as std::from_chars into a value initialized to 0
+constexpr double parse_number(const DisplayText &str) {
+	if (!__builtin_is_constant_evaluated()) {
+		char buffer[DisplayText::MAX_LENGTH] = {};
+		for (int i = 0; i < str.size(); ++i)
+			buffer[i] = (str[i] < 0x100) ? char(str[i]) : '?';
+		double value = 0;
+		std::from_chars(buffer, buffer + str.size(), value);
+		return value;
+	}
+
+	auto is_digit = [&str](const int i) {
+		return i < str.size() && str[i] >= u'0' && str[i] <= u'9';
+	};
+	int i = 0;
+	const bool negative = str.starts_with(u'-');
+	if (negative)
+		++i;
+	if (i + 3 <= str.size() && str[i] == u'i' && str[i + 1] == u'n'
+		&& str[i + 2] == u'f') {
+		return negative ? -INFINITY : INFINITY;
+	}
+	if (i + 3 <= str.size() && str[i] == u'n' && str[i + 1] == u'a'
+		&& str[i + 2] == u'n') {
+		return NAN;
+	}
+	BigInt mantissa;
+	int exponent = 0;
+	bool has_digits = false;
+	for (; is_digit(i); ++i) {
+		mantissa.multiply_add(10, str[i] - u'0');
+		has_digits = true;
+	}
+	if (i < str.size() && str[i] == u'.') {
+		for (++i; is_digit(i); ++i) {
+			mantissa.multiply_add(10, str[i] - u'0');
+			--exponent;
+			has_digits = true;
+		}
+	}
+	if (!has_digits)
+		return 0;
+	// the exponent is only read if it has digits
+	if (i < str.size() && (str[i] == u'e' || str[i] == u'E')) {
+		int j = i + 1;
+		bool negative_exponent = false;
+		if (j < str.size() && (str[j] == u'+' || str[j] == u'-'))
+			negative_exponent = (str[j++] == u'-');
+		int power = 0;
+		for (; is_digit(j); ++j)
+			power = std::min(power * 10 + (str[j] - u'0'), 100000);
+		exponent += negative_exponent ? -power : power;
+	}
+	return exact_decimal_to_double(mantissa, exponent, negative);
+}
+
+//-----------------------------arithmetic----------------------------
+
+// because cmath doesn't have a factorial function
+// only defined to 20!
+constexpr long long factorial(int n) {
+	if (n < 0 || n >= 21)
+		return -1;
+	long long fact = 1;
+	for (int i=1; i <= n; ++i)
+		fact *= i;
+	return fact;
+}
+
+// constant evaluation rejects an arithmetic overflow, so at compile time
+// results that would overflow are found to be inf beforehand
+// returns whether value, the exact result found in long double, is too big
+// for a double, setting result to the inf it would round to
+constexpr bool overflows(const long double value, double &result) {
+	// the smallest magnitude that rounds to inf
+	const long double limit = 0x1p1024L - 0x1p970L;
+	if (value > -limit && value < limit)
+		return false;
+	result = (value > 0) ? INFINITY : -INFINITY;
+	return true;
+}
+
+// the parts of calculate_binary() that differ at compile time, where
+// overflow, division by 0 and pow underflowing to a subnormal or
+// overflowing aren't constant expressions, returns whether result has been set
+constexpr bool calculate_constant(const char binary_op, const double up,
+								  const double lo, double &result) {
+	switch (binary_op) {
+		case '+':
+			return overflows((long double)up + lo, result);
+		case '-':
+			return overflows((long double)up - lo, result);
+		case 'x':
+			return overflows((long double)up * lo, result);
+		case 'd':
+			return lo != 0 && overflows((long double)up / lo, result);
+		case '^':
+			if (up == 0) {
+				if (lo >= 0)
+					return false;
+				result = INFINITY;
+				return true;
+			}
+		{
+			// the binary exponent of the result, in long double so it
+			// can't overflow itself
+			const long double bits = (long double)lo * std::log2(std::fabs(up));
+			// a result near or below the smallest normal double
+			if (bits < -1021) {
+				result = std::pow((long double)up, (long double)lo);
+				return true;
+			}
+			// beyond the range of a long double too
+			if (bits > 16000) {
+				result = (up > 0) ? INFINITY : (std::fmod(lo, 1) != 0) ? NAN
+						 : (std::fmod(lo, 2) != 0) ? -INFINITY : INFINITY;
+				return true;
+			}
+			return bits > 1023
+				   && overflows(std::pow((long double)up, (long double)lo),
+								result);
+		}
+		case 'l':
+			if (std::log(up) != 0)
+				return false;
+			result = (std::log(lo) == 0) ? NAN
+					 : (std::log(lo) > 0) ? INFINITY : -INFINITY;
+			return true;
+	}
+	return false;
+}
+
+// returns the result of binary_op applied to up and lo
+constexpr double calculate_binary(const char binary_op, const double up,
+								  const double lo) {
+	if (__builtin_is_constant_evaluated()) {
+		double result = 0;
+		if (calculate_constant(binary_op, up, lo, result))
+			return result;
+	}
+	switch (binary_op) {
+		case '+':
+			return up + lo;
+		case '-':
+			return up - lo;
+		case 'x':
+			return up * lo;
+		case 'd':
+			return up / lo;
+		case '^':
+			return std::pow(up, lo);
+		case 'l': // log base up of lo
+			return std::log(lo) / std::log(up);
+		case 'm':
+			return std::fmod(up, lo);
+	}
+	return -420;
+}
+
+// returns the result of unary_op applied to value
+constexpr double calculate_unary(const char unary_op, const double value) {
+	switch (unary_op) {
+		case 'r':
+			return std::sqrt(value);
+		case '!':
+			return factorial(value);
+		case 'i':
+			if (__builtin_is_constant_evaluated()) {
+				double result = 0;
+				if (value == 0 || overflows(1.0L / value, result))
+					return (value == 0) ? INFINITY : result;
+			}
+			return 1.0 / value;
+	}
+	return -69;
+}
+
+//-------------------------precise arithmetic------------------------
+
+// counts how often calculate_displayed() had to redo an operation
+struct PrecisionCounters {
+	long long evaluated = 0;
+	long long escalated = 0;
+};
+
+// an unevaluated sum hi + lo, good for about 32 significant digits
+struct DoubleDouble {
+	double hi;
+	double lo;
+};
+
+// the relative error a result can have and still show the right digits,
+// with two digits to spare for results that land near a rounding boundary
+// 10^-(DISPLAY_PRECISION + 2), a literal since std::pow isn't constexpr
+constexpr double TRUSTED_ERROR = 1e-12;
+// the relative error of rounding a decimal to a double
+constexpr double UNIT_ROUNDOFF = 0x1p-53;
+
+// a + b exactly, for any doubles
+constexpr DoubleDouble two_sum(const double a, const double b) {
+	double sum = a + b;
+	double b_part = sum - a;
+	double error = (a - (sum - b_part)) + (b - b_part);
+	return { sum, error };
+}
+
+constexpr DoubleDouble add_double_double(const DoubleDouble &a,
+										 const DoubleDouble &b) {
+	DoubleDouble sum = two_sum(a.hi, b.hi);
+	return two_sum(sum.hi, sum.lo + a.lo + b.lo);
+}
+
+// returns the decimal value shows as a double-double, so it no longer
+// carries the error of rounding to a double
+constexpr DoubleDouble exact_decimal(const double value) {
+	long long mantissa = 0;
+	int exponent = 0;
+	display_digits(value, mantissa, exponent);
+	// the mantissa has at most ten digits, so it is exact as a double
+	const double digits = mantissa;
+	if (exponent >= 0 && exponent <= MAX_EXACT_POW10) {
+		const double power = EXACT_POW10[exponent];
+		double hi = digits * power;
+		return { hi, std::fma(digits, power, -hi) };
+	}
+	if (exponent < 0 && -exponent <= MAX_EXACT_POW10) {
+		const double power = EXACT_POW10[-exponent];
+		double hi = digits / power;
+		double remainder = std::fma(-hi, power, digits);
+		return { hi, remainder / power };
+	}
+	return { value, 0 };
+}
+
+// the natural log of a displayed value, accurate even very close to 1
+constexpr double precise_log(const double value) {
+	DoubleDouble offset = add_double_double(exact_decimal(value), { -1, 0 });
+	return std::log1p(offset.hi + offset.lo);
+}
+
+// up mod lo on the exact decimals, as integers scaled to a common exponent
+// returns fallback if the scaled values don't fit a long long
+constexpr double precise_mod(const double up, const double lo,
+							 const double fallback) {
+	long long up_digits = 0, lo_digits = 0;
+	int up_exponent = 0, lo_exponent = 0;
+	display_digits(up, up_digits, up_exponent);
+	display_digits(lo, lo_digits, lo_exponent);
+	int exponent = std::min(up_exponent, lo_exponent);
+	if (up_exponent - exponent > 18 || lo_exponent - exponent > 18)
+		return fallback;
+	long long up_scaled = 0, lo_scaled = 0;
+	if (__builtin_mul_overflow(up_digits, (long long)EXACT_POW10[up_exponent
+							   - exponent], &up_scaled)
+		|| __builtin_mul_overflow(lo_digits, (long long)EXACT_POW10[
+								  lo_exponent - exponent], &lo_scaled)) {
+		return fallback;
+	}
+	// % truncates like fmod, so the result has the sign of up
+	double remainder = up_scaled % lo_scaled;
+	if (exponent >= 0)
+		return remainder * std::pow(10.0, exponent);
+	if (-exponent <= MAX_EXACT_POW10)
+		return remainder / EXACT_POW10[-exponent];
+	return remainder / std::pow(10.0, -exponent);
+}
+
+// like calculate_binary(), for up and lo that are displayed values
+// the result is computed in double along with a bound on the error from
+// rounding up and lo to doubles, and when that could change the displayed
+// digits it is redone from their exact decimals in double-double precision
+// this only happens with cancellation in + - and m, or for logs near 1
+// counters, if given, records every call and every escalation
+constexpr double calculate_displayed(const char binary_op, const double up,
+									 const double lo,
+									 PrecisionCounters *counters) {
+	const double value = calculate_binary(binary_op, up, lo);
+	if (counters)
+		++counters->evaluated;
+	// the relative error of value caused by the rounding of up and lo
+	double bound = 0;
+	switch (binary_op) {
+		case '+':
+		case '-':
+			// an exact zero means up and lo were the same decimal
+			if (value != 0)
+				bound = UNIT_ROUNDOFF * (std::abs(up) + std::abs(lo))
+						/ std::abs(value);
+			break;
+		case 'l':
+			if (std::log(up) == 0 || std::log(lo) == 0)
+				bound = INFINITY;
+			else
+				bound = UNIT_ROUNDOFF * (1 / std::abs(std::log(up))
+										 + 1 / std::abs(std::log(lo)));
+			break;
+		case 'm': {
+			// the error of up plus the error of lo times the quotient
+			double error = 2 * UNIT_ROUNDOFF * std::abs(up);
+			// close to lo the exact result could wrap around to 0
+			if (value == 0 || std::abs(lo) - std::abs(value) <= error)
+				bound = INFINITY;
+			else
+				bound = error / std::abs(value);
+			break;
+		}
+	}
+	if (!(bound > TRUSTED_ERROR) || !std::isfinite(value))
+		return value;
+
+	if (counters)
+		++counters->escalated;
+	switch (binary_op) {
+		case '+': {
+			DoubleDouble sum = add_double_double(exact_decimal(up),
+												 exact_decimal(lo));
+			return sum.hi + sum.lo;
+		}
+		case '-': {
+			DoubleDouble lo_exact = exact_decimal(lo);
+			DoubleDouble difference = add_double_double(exact_decimal(up),
+												{ -lo_exact.hi, -lo_exact.lo });
+			return difference.hi + difference.lo;
+		}
+		case 'l':
+			return precise_log(lo) / precise_log(up);
+		case 'm':
+			return precise_mod(up, lo, value);
+	}
+	return value;
+}
+
+//----------------------------error checks---------------------------
+
+// these return the error message for invalid inputs, or nullptr if valid
+// all error messages contain the string "error" in them
+// returns errors regarding invalid inputs to the binary operator
+constexpr const char *binary_error(const char binary_op, const double up,
+								   const double lo) {
+	switch (binary_op) {
+		case '^':
+			if (up == 0 && lo == 0)
+				return "0^0 error";
+			else if (up < 0 && std::fmod(lo, 1) != 0)
+				return "neg root error";
+			break;
+		case 'd':
+			if (lo == 0)
+				return "divide by 0 error";
+			break;
+		case 'l':
+			if (up == 0 || lo == 0)
+				return "log 0 error";
+			else if (up < 0 || lo < 0)
+				return "neg log error";
+			break;
+		case 'm':
+			if (lo == 0)
+				return "mod 0 error";
+			break;
+	}
+	return nullptr;
+}
+
+// returns errors regarding invalid inputs to the unary operator
+constexpr const char *unary_error(const char unary_op, const double value) {
+	switch (unary_op) {
+		case 'r':
+			if (value < 0)
+				return "neg root error";
+			break;
+		case '!':
+			if (value < 0)
+				return "neg factorial error";
+			else if (value >= 21)
+				return "factorial size error";
+			else if (std::fmod(value, 1) != 0)
+				return "dec factorial error";
+			break;
+		case 'i':
+			if (value == 0)
+				return "inverse 0 error";
+			break;
+	}
+	return nullptr;
+}
+
+// returns errors for a formatted value equaling inf, -inf, or nan
+constexpr const char *number_error(const DisplayText &value) {
+	if (value == DisplayText(u"inf"))
+		return "max size error";
+	else if (value == DisplayText(u"-inf"))
+		return "min size error";
+	else if (value == DisplayText(u"nan"))
+		return "nan error";
+	return nullptr;
+}
+
+//----------------------------display editing------------------------
+
+// these return false if the edit isn't allowed, leaving str unchanged
+// checks if str is at the max precision
+constexpr bool at_max_precision(const DisplayText &str) {
+	int exp_pos = str.index_of(u'e');
+	if (exp_pos != -1) {
+		// compare the length of the numbers starting after e
+		return (str.size() - (exp_pos + 2)) >= EXPONENT_PRECISION;
+	} else {
+		// count the digits, skipping non significant features
+		int length = 0;
+		bool first_digit = true;
+		for (int i = 0; i < str.size(); ++i) {
+			if (str[i] == u'-')
+				continue;
+			if (first_digit) {
+				first_digit = false;
+				if (str[i] == u'0')
+					continue;
+			}
+			if (str[i] != u'.')
+				++length;
+		}
+		return length >= DISPLAY_PRECISION;
+	}
+}
+
+// adds a digit or decimal point to str, replacing it if overwrite is set
+constexpr bool edit_digit(DisplayText &str, bool &overwrite,
+						  const char digit) {
+	if (digit == '0' && str == DisplayText(u"0"))
+		return false;
+
+	// handle overwriting the display
+	if (overwrite) {
+		overwrite = (digit == '0');
+		str = (digit == '.') ? DisplayText(u"0") : DisplayText();
+	} else {
+		if (at_max_precision(str))
+			return false;
+		if ((digit == '0') &&
+			(str.ends_with(u"e+") || str.ends_with(u"e-"))) {
+			return false;
+		} else if ((digit == '.') &&
+			(str.contains(u'.') || str.contains(u'e'))) {
+			return false;
+		}
+	}
+	str.append(digit);
+	return true;
+}
+
+// appends 'e+' to str, clearing overwrite
+constexpr bool edit_scientific(DisplayText &str, bool &overwrite) {
+	if (str.contains(u'e') || parse_number(str) == 0.0)
+		return false;
+	// scientific has a unique overwrite reaction
+	// it allows a number to append a new exponent even if it was calculated
+	overwrite = false;
+	str.append(u'e');
+	str.append(u'+');
+	return true;
+}
+
+// swaps the sign of str, or the sign of its exponent if it has one
+constexpr bool edit_sign(DisplayText &str) {
+	if (str == DisplayText(u"0"))
+		return false;
+
+	int exp_pos = str.index_of(u'e');
+	if (exp_pos != -1 && exp_pos + 1 < str.size())
+		str.set(exp_pos + 1, (str[exp_pos + 1] == u'+') ? u'-' : u'+');
+	else if (str.starts_with(u'-'))
+		str.remove(0);
+	else
+		str.prepend(u'-');
+	return true;
+}
+
+//-------------------------------results-----------------------------
+
+// replaces value with unary_op applied to it, or with the error message
+// returns whether it is an error
+constexpr bool unary_result(const char unary_op, DisplayText &value) {
+	double number = parse_number(value);
+	const char *error = unary_error(unary_op, number);
+	if (!error) {
+		value = format_number(calculate_unary(unary_op, number));
+		error = number_error(value);
+	}
+	if (error)
+		value = DisplayText::from_latin1(error);
+	return error != nullptr;
+}
+
+// sets result to what equals shows for upper and lower, where binary_op is
+// pending if lower isn't empty, and otherwise the repeat op is applied
+// a pending op becomes the repeat op, returns whether result is an error
+constexpr bool equals_result(const DisplayText &upper,
+							 const DisplayText &lower, const char binary_op,
+							 char &repeat_op, double &repeat_operand,
+							 PrecisionCounters *counters,
+							 DisplayText &result) {
+	// either recalculate the upper value or attempt the binary calculation
+	double value = parse_number(upper);
+	if (!lower.is_empty()) {
+		repeat_op = binary_op;
+		repeat_operand = parse_number(lower);
+	}
+	const char *error = nullptr;
+	if (repeat_op != '\0') {
+		error = binary_error(repeat_op, value, repeat_operand);
+		if (!error)
+			value = calculate_displayed(repeat_op, value, repeat_operand,
+										counters);
+	}
+	if (!error) {
+		result = format_number(value);
+		error = number_error(result);
+	}
+	if (error)
+		result = DisplayText::from_latin1(error);
+	return error != nullptr;
+}
+
+//--------------------------keystroke evaluator----------------------
+
+// the part of the calculator state the displays show, without memory,
+// undo, or the panels
+struct CalcState {
+	DisplayText upper = u"0";
+	DisplayText lower;
+	// lower is active from a binary op until equals or clear
+	bool lower_active = false;
+	char binary_op = '\0';
+	bool overwrite = true;
+	bool has_error = false;
+	// the op and lower value equals repeats without a lower value
+	char repeat_op = '\0';
+	double repeat_operand = 0;
+};
+
+// applies event to state like Calculator::do_event() would
+// handles digits, '.', e, s, the binary and unary ops, q and c
+// returns false if the event is ignored or not handled
+constexpr bool apply_event(CalcState &state, const char event) {
+	DisplayText &active = state.lower_active ? state.lower : state.upper;
+	switch (event) {
+		case '0' ... '9':
+		case '.': {
+			bool clears_error = state.overwrite;
+			if (!edit_digit(active, state.overwrite, event))
+				return false;
+			if (clears_error)
+				state.has_error = false;
+			return true;
+		}
+		case '+':
+		case '-':
+		case 'x':
+		case 'd':
+		case '^':
+		case 'l':
+		case 'm':
+			if (state.has_error)
+				return false;
+			if (state.lower_active && event == state.binary_op)
+				return false;
+			state.binary_op = event;
+			if (!state.lower_active) {
+				state.lower_active = true;
+				state.overwrite = true;
+				state.lower = u"0";
+			}
+			return true;
+		case 'r':
+		case 'i':
+		case '!':
+			if (state.has_error)
+				return false;
+			state.has_error = unary_result(event, active);
+			state.overwrite = true;
+			return true;
+		case 'e':
+			return !state.has_error && edit_scientific(active, state.overwrite);
+		case 's':
+			return !state.has_error && edit_sign(active);
+		case 'q': {
+			if (state.has_error)
+				return false;
+			DisplayText result;
+			state.has_error = equals_result(state.upper, state.lower,
+											state.binary_op, state.repeat_op,
+											state.repeat_operand, nullptr,
+											result);
+			state.upper = result;
+			state.lower.clear();
+			state.lower_active = false;
+			state.overwrite = true;
+			return true;
+		}
+		case 'c':
+			state = CalcState();
+			return true;
+	}
+	return false;
+}
+
+// returns the state after typing keys into a cleared calculator
+// keys are event chars, unhandled ones are ignored like the calculator does
+constexpr CalcState evaluate_keys(const char *keys) {
+	CalcState state;
+	for (; *keys != '\0'; ++keys)
+		apply_event(state, *keys);
+	return state;
+}
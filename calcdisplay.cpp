@@ -0,0 +1,245 @@
+#include "calcdisplay.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QContextMenuEvent>
+#include <QGuiApplication>
+#include <QMenu>
+
+#include <algorithm>
+
+// the longest strings a display is expected to hold, used for the size hint
+static const char *const WIDEST_TEXTS[] = {
+	"-8.888888888e-888", "factorial size error", "neg factorial error"
+};
+
+//----------------------------constructor----------------------------
+
+// sets the same font and frame style as CalcLabel
+CalcDisplay::CalcDisplay(QWidget *parent) : QFrame(parent) {
+	// make the font slightly bigger
+	QFont new_font = font();
+	new_font.setPointSize(new_font.pointSize() + 1);
+	setFont(new_font);
+	setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
+
+	setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed));
+	setCursor(Qt::IBeamCursor);
+	setContextMenuPolicy(Qt::DefaultContextMenu);
+	// all drawing happens in paintEvent, let Qt skip erasing the background
+	setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+//----------------------------text access----------------------------
+
+QString CalcDisplay::text() const {
+	return cur_text.to_string();
+}
+
+// a view of the inline text buffer, for reading without a copy
+QStringView CalcDisplay::view() const {
+	return cur_text.view();
+}
+
+// replaces the text, repaints only the glyphs that moved or changed
+// the text is copied into an inline buffer, so this never allocates
+void CalcDisplay::setText(QStringView new_text) {
+	new_text = new_text.left(DisplayText::MAX_LENGTH);
+	if (new_text == cur_text.view())
+		return;
+
+	// the text is right aligned, so a common suffix keeps its position
+	int suffix = 0;
+	int max_suffix = std::min<int>(cur_text.size(), new_text.size());
+	while (suffix < max_suffix &&
+		   cur_text[cur_text.size() - 1 - suffix] ==
+		   new_text[new_text.size() - 1 - suffix].unicode()) {
+		++suffix;
+	}
+	int new_width = width_of(new_text, 0, new_text.size());
+	int suffix_width = width_of(new_text, new_text.size() - suffix,
+								new_text.size());
+
+	QRect area = contentsRect();
+	int right = area.right() + 1;
+	int dirty_left = right - std::max(text_width, new_width);
+	int dirty_right = right - suffix_width;
+	if (has_selection())
+		dirty_left = area.left();
+
+	cur_text = new_text;
+	text_width = new_width;
+	sel_anchor = sel_end = 0;
+	if (dirty_left < dirty_right) {
+		update(QRect(dirty_left, area.top(), dirty_right - dirty_left,
+					 area.height()));
+	}
+}
+
+//-----------------------------size hints----------------------------
+
+// the size never depends on the text, so setText() can't cause relayout
+QSize CalcDisplay::sizeHint() const {
+	QSize size = minimumSizeHint();
+	size.rwidth() = std::max(size.width(), 50);
+	return size;
+}
+
+QSize CalcDisplay::minimumSizeHint() const {
+	QFontMetrics metrics = fontMetrics();
+	int width = 0;
+	for (const char *str : WIDEST_TEXTS) {
+		width = std::max(width,
+						 metrics.horizontalAdvance(QLatin1String(str)));
+	}
+	int frame = 2 * frameWidth();
+	return QSize(width + frame + 2, metrics.height() + frame + 2);
+}
+
+//------------------------------painting-----------------------------
+
+void CalcDisplay::paintEvent(QPaintEvent *event) {
+	QPainter painter(this);
+	painter.fillRect(event->rect(), palette().brush(backgroundRole()));
+	drawFrame(&painter);
+
+	QRect area = contentsRect();
+	painter.setClipRect(area & event->rect());
+	int x = text_left();
+	int y = area.top() + (area.height() - fontMetrics().height()) / 2;
+	int sel_low = std::min(sel_anchor, sel_end);
+	int sel_high = std::max(sel_anchor, sel_end);
+
+	for (int i = 0; i < cur_text.size(); ++i) {
+		const Glyph &g = glyph(QChar(cur_text[i]));
+		// skip glyphs outside of the dirty region
+		if (x + g.advance >= event->rect().left() &&
+			x <= event->rect().right()) {
+			if (i >= sel_low && i < sel_high) {
+				painter.fillRect(QRect(x, area.top(), g.advance, area.height()),
+								 palette().brush(QPalette::Highlight));
+				painter.setPen(palette().color(QPalette::HighlightedText));
+			} else {
+				painter.setPen(palette().color(foregroundRole()));
+			}
+			painter.drawStaticText(x, y, g.text);
+		}
+		x += g.advance;
+	}
+}
+
+//------------------------------selection----------------------------
+
+void CalcDisplay::mousePressEvent(QMouseEvent *event) {
+	if (event->button() != Qt::LeftButton)
+		return QFrame::mousePressEvent(event);
+	int index = index_at(event->pos().x());
+	select(index, index);
+}
+
+void CalcDisplay::mouseMoveEvent(QMouseEvent *event) {
+	if (!(event->buttons() & Qt::LeftButton))
+		return QFrame::mouseMoveEvent(event);
+	select(sel_anchor, index_at(event->pos().x()));
+}
+
+void CalcDisplay::mouseReleaseEvent(QMouseEvent *event) {
+	if (event->button() != Qt::LeftButton)
+		return QFrame::mouseReleaseEvent(event);
+	copy_selection(QClipboard::Selection);
+}
+
+void CalcDisplay::mouseDoubleClickEvent(QMouseEvent *event) {
+	if (event->button() != Qt::LeftButton)
+		return QFrame::mouseDoubleClickEvent(event);
+	select(0, cur_text.size());
+	copy_selection(QClipboard::Selection);
+}
+
+void CalcDisplay::contextMenuEvent(QContextMenuEvent *event) {
+	QMenu menu(this);
+	QAction *copy = menu.addAction("&Copy", [this] {
+		copy_selection(QClipboard::Clipboard);
+	});
+	copy->setEnabled(has_selection());
+	menu.addAction("Select All", [this] {
+		select(0, cur_text.size());
+	});
+	menu.exec(event->globalPos());
+}
+
+bool CalcDisplay::has_selection() const {
+	return sel_anchor != sel_end;
+}
+
+void CalcDisplay::select(const int anchor, const int end) {
+	if (anchor == sel_anchor && end == sel_end)
+		return;
+	sel_anchor = anchor;
+	sel_end = end;
+	update(contentsRect());
+}
+
+void CalcDisplay::copy_selection(const QClipboard::Mode mode) {
+	QClipboard *clipboard = QGuiApplication::clipboard();
+	if (!has_selection())
+		return;
+	if (mode == QClipboard::Selection && !clipboard->supportsSelection())
+		return;
+	int low = std::min(sel_anchor, sel_end);
+	int high = std::max(sel_anchor, sel_end);
+	clipboard->setText(cur_text.view().mid(low, high - low).toString(), mode);
+}
+
+//-------------------------------glyphs------------------------------
+
+// drops the glyph cache when the font changes
+void CalcDisplay::changeEvent(QEvent *event) {
+	if (event->type() == QEvent::FontChange) {
+		glyph_cache.clear();
+		text_width = width_of(cur_text.view(), 0, cur_text.size());
+		updateGeometry();
+		update();
+	}
+	QFrame::changeEvent(event);
+}
+
+// returns the cached glyph for c, shaping it on first use
+const CalcDisplay::Glyph &CalcDisplay::glyph(const QChar c) {
+	auto it = glyph_cache.constFind(c);
+	if (it != glyph_cache.constEnd())
+		return *it;
+	Glyph g;
+	g.text.setText(QString(c));
+	g.text.setTextFormat(Qt::PlainText);
+	g.text.setPerformanceHint(QStaticText::AggressiveCaching);
+	g.text.prepare(QTransform(), font());
+	g.advance = fontMetrics().horizontalAdvance(c);
+	return *glyph_cache.insert(c, g);
+}
+
+// the width of the characters in str from index from up to index to
+int CalcDisplay::width_of(QStringView str, int from, int to) {
+	int width = 0;
+	for (int i = from; i < to; ++i)
+		width += glyph(str[i]).advance;
+	return width;
+}
+
+// the x position of the first character of cur_text
+int CalcDisplay::text_left() const {
+	return contentsRect().right() + 1 - text_width;
+}
+
+// the character boundary closest to x
+int CalcDisplay::index_at(const int x) {
+	int pos = text_left();
+	for (int i = 0; i < cur_text.size(); ++i) {
+		int advance = glyph(QChar(cur_text[i])).advance;
+		if (x < pos + advance / 2)
+			return i;
+		pos += advance;
+	}
+	return cur_text.size();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "displaytext.h"
+#include <QFrame>
+#include <QHash>
+#include <QStaticText>
+#include <QString>
+#include <QClipboard>
+
+// a right aligned number display that draws its text from cached glyphs
+// the display only ever shows short strings from a small alphabet, so each
+// character is shaped once into a QStaticText and reused for every setText()
+// setText() never changes the size hint and only repaints the changed region
+class CalcDisplay : public QFrame {
+public:
+	// sets the same font and frame style as CalcLabel
+	CalcDisplay(QWidget *parent);
+
+	QString text() const;
+	// a view of the inline text buffer, for reading without a copy
+	QStringView view() const;
+	// replaces the text, repaints only the glyphs that moved or changed
+	// the text is copied into an inline buffer, so this never allocates
+	void setText(QStringView new_text);
+
+	// the size never depends on the text, so setText() can't cause relayout
+	QSize sizeHint() const;
+	QSize minimumSizeHint() const;
+
+protected:
+	void paintEvent(QPaintEvent *event);
+	// mouse selection, mirrors QLabel's Qt::TextSelectableByMouse
+	void mousePressEvent(QMouseEvent *event);
+	void mouseMoveEvent(QMouseEvent *event);
+	void mouseReleaseEvent(QMouseEvent *event);
+	void mouseDoubleClickEvent(QMouseEvent *event);
+	void contextMenuEvent(QContextMenuEvent *event);
+	// drops the glyph cache when the font changes
+	void changeEvent(QEvent *event);
+
+private:
+	// a pre-shaped character and how far it advances the pen
+	struct Glyph {
+		QStaticText text;
+		int advance;
+	};
+	QHash<QChar, Glyph> glyph_cache;
+
+	DisplayText cur_text;
+	// cached sum of the advances of cur_text
+	int text_width = 0;
+	// the selection as character indices, unordered
+	int sel_anchor = 0;
+	int sel_end = 0;
+
+	// returns the cached glyph for c, shaping it on first use
+	const Glyph &glyph(const QChar c);
+	// the width of the characters in str from index from up to index to
+	int width_of(QStringView str, int from, int to);
+	// the x position of the first character of cur_text
+	int text_left() const;
+	// the character boundary closest to x
+	int index_at(const int x);
+
+	bool has_selection() const;
+	void select(const int anchor, const int end);
+	void copy_selection(const QClipboard::Mode mode);
+};
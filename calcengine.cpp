@@ -0,0 +1,83 @@
+#include "calcengine.h"
+
+#include <cmath>
+
+//----------------------------evaluation-----------------------------
+
+// applies step to a single value, nan on an error
+static double evaluate_step(const CalcStep &step, const double value) {
+	if (std::isnan(value))
+		return value;
+	switch (step.op) {
+		case 'r':
+		case 'i':
+		case '!':
+			if (unary_error(step.op, value))
+				return NAN;
+			return calculate_unary(step.op, value);
+		case 'q':
+			return value;
+	}
+	if (binary_error(step.op, value, step.operand))
+		return NAN;
+	return calculate_binary(step.op, value, step.operand);
+}
+
+// applies steps in order to each of values
+// each step runs over all values before the next, so the simple arithmetic
+// steps are plain loops the compiler can vectorise
+void evaluate_steps(const CalcStep *steps, const int step_count, 
+					double *values, const int count) {
+	for (int s = 0; s < step_count; ++s) {
+		const CalcStep &step = steps[s];
+		const double lo = step.operand;
+		switch (step.op) {
+			// nan propagates through these without any checks
+			case '+':
+				for (int i = 0; i < count; ++i)
+					values[i] += lo;
+				break;
+			case '-':
+				for (int i = 0; i < count; ++i)
+					values[i] -= lo;
+				break;
+			case 'x':
+				for (int i = 0; i < count; ++i)
+					values[i] *= lo;
+				break;
+			case 'd':
+				if (lo == 0) {
+					for (int i = 0; i < count; ++i)
+						values[i] = NAN;
+				} else {
+					for (int i = 0; i < count; ++i)
+						values[i] /= lo;
+				}
+				break;
+			default:
+				for (int i = 0; i < count; ++i)
+					values[i] = evaluate_step(step, values[i]);
+		}
+		// overflow is an error too
+		for (int i = 0; i < count; ++i) {
+			if (!std::isfinite(values[i]))
+				values[i] = NAN;
+		}
+	}
+}
+
+//--------------------------compile time checks----------------------
+
+// the keystroke evaluator runs the same rules as the calculator, so these
+// fail the build if a rule stops being usable at compile time
+// only GCC evaluates cmath functions at compile time, other compilers rely
+// on tests/coretest, which also checks the results match the runtime ones
+#if defined(__GNUC__) && !defined(__clang__)
+static_assert(evaluate_keys("2+3q").upper == DisplayText(u"5"));
+static_assert(evaluate_keys("1m.1q").upper == DisplayText(u"0"));
+static_assert(evaluate_keys(".1+.2q").upper == DisplayText(u"0.3"));
+static_assert(evaluate_keys("2^.5q").upper == DisplayText(u"1.414213562"));
+static_assert(evaluate_keys("5d0q").upper == DisplayText(u"divide by 0 error"));
+static_assert(evaluate_keys("1e300x1e300q").upper
+			  == DisplayText(u"max size error"));
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "calccore.h"
+
+// the calculator's arithmetic, shared by the displays, macros and the graph
+// none of these depend on display state
+// the scalar rules live in calccore.h, this adds evaluating many values
+
+// an operation with its lower value fixed
+struct CalcStep {
+	// a binary op, a unary op, or 'q' for an equals that repeats in macros
+	char op;
+	// the lower value for binary ops
+	double operand;
+};
+
+// applies steps in order to each of values
+// an input error or a result of inf or nan makes the value nan
+// 'q' steps are ignored, so repeats have to be resolved first
+void evaluate_steps(const CalcStep *steps, const int step_count, 
+					double *values, const int count);
@@ -0,0 +1,458 @@
+#include "calcmatrix.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+
+// the doubles in the widest SIMD register the target has, so the kernel
+// compiles to whatever the build flags allow, SSE2 at least on x86-64
+#if defined(__AVX512F__)
+static const int VEC_SIZE = 8;
+#elif defined(__AVX__)
+static const int VEC_SIZE = 4;
+#else
+static const int VEC_SIZE = 2;
+#endif
+// the lower alignment lets a Vec load from any entry of a row
+typedef double Vec __attribute__((vector_size(VEC_SIZE * sizeof(double)),
+								  aligned(sizeof(double)), may_alias));
+
+// the register block, the kernel keeps MR by NR entries of the result in
+// twelve vector registers, enough independent sums to hide the latency
+static const int MR = 6;
+static const int NR = 2 * VEC_SIZE;
+// the cache blocks, a packed MC by KC block of a is meant to stay in L2 and
+// a packed KC by NC block of b in L3
+static const int MC = 96;
+static const int KC = 256;
+static const int NC = 1024;
+// products with fewer multiply-adds than this run on a single thread
+static const double MIN_PARALLEL = 1 << 22;
+// the panel width of the blocked LU decomposition and triangular solves
+static const int LU_BLOCK = 64;
+
+//------------------------------Matrix-------------------------------
+
+Matrix::Matrix(const int rows_in, const int cols_in)
+: n_rows(rows_in), n_cols(cols_in),
+  values(static_cast<std::size_t>(rows_in) * cols_in) {}
+
+int Matrix::rows() const {
+	return n_rows;
+}
+
+int Matrix::cols() const {
+	return n_cols;
+}
+
+bool Matrix::is_empty() const {
+	return values.empty();
+}
+
+double &Matrix::at(const int row, const int col) {
+	return values[static_cast<std::size_t>(row) * n_cols + col];
+}
+
+double Matrix::at(const int row, const int col) const {
+	return values[static_cast<std::size_t>(row) * n_cols + col];
+}
+
+double *Matrix::data() {
+	return values.data();
+}
+
+const double *Matrix::data() const {
+	return values.data();
+}
+
+//-----------------------------helpers-------------------------------
+
+// returns the calculator's error for a matrix with an inf or nan entry
+static const char *entries_error(const Matrix &m) {
+	const double *x = m.data();
+	const std::size_t count = static_cast<std::size_t>(m.rows()) * m.cols();
+	for (std::size_t i = 0; i < count; ++i) {
+		if (std::isnan(x[i]))
+			return "nan error";
+		if (std::isinf(x[i]))
+			return "max size error";
+	}
+	return nullptr;
+}
+
+// returns threads, or one per core if it isn't positive
+static int thread_count(const int threads) {
+	if (threads > 0)
+		return threads;
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//----------------------------element wise---------------------------
+
+// sets result to op applied to each pair of entries of a and b
+// op takes both doubles and Vecs, so all but the last few entries are
+// done a vector at a time
+template <typename Op>
+static const char *element_wise(const Matrix &a, const Matrix &b,
+								Matrix &result, const Op &op) {
+	if (a.rows() != b.rows() || a.cols() != b.cols())
+		return "matrix size error";
+	result = Matrix(a.rows(), a.cols());
+	const double *x = a.data();
+	const double *y = b.data();
+	double *z = result.data();
+	const std::size_t count = static_cast<std::size_t>(a.rows()) * a.cols();
+	std::size_t i = 0;
+	for (; i + VEC_SIZE <= count; i += VEC_SIZE) {
+		*reinterpret_cast<Vec *>(z + i) =
+			op(*reinterpret_cast<const Vec *>(x + i),
+			   *reinterpret_cast<const Vec *>(y + i));
+	}
+	for (; i < count; ++i)
+		z[i] = op(x[i], y[i]);
+	return entries_error(result);
+}
+
+// result = a + b
+const char *matrix_add(const Matrix &a, const Matrix &b, Matrix &result) {
+	return element_wise(a, b, result, [](auto x, auto y) { return x + y; });
+}
+
+// result = a - b
+const char *matrix_subtract(const Matrix &a, const Matrix &b, Matrix &result) {
+	return element_wise(a, b, result, [](auto x, auto y) { return x - y; });
+}
+
+//------------------------------product------------------------------
+
+// packs the m by k block of a into slivers of MR rows, each stored column
+// by column so the kernel reads it in order, padding the last with zeros
+static void pack_a(const int m, const int k, const double *a, const int lda,
+				   double *packed) {
+	for (int i0 = 0; i0 < m; i0 += MR) {
+		for (int p = 0; p < k; ++p) {
+			for (int i = i0; i < i0 + MR; ++i)
+				*packed++ = (i < m) ? a[static_cast<std::ptrdiff_t>(i) * lda + p] : 0;
+		}
+	}
+}
+
+// packs the k by n block of b into slivers of NR columns, each stored row
+// by row so the kernel reads it in order, padding the last with zeros
+static void pack_b(const int k, const int n, const double *b, const int ldb,
+				   double *packed) {
+	for (int j0 = 0; j0 < n; j0 += NR) {
+		for (int p = 0; p < k; ++p) {
+			const double *row = b + static_cast<std::ptrdiff_t>(p) * ldb;
+			for (int j = j0; j < j0 + NR; ++j)
+				*packed++ = (j < n) ? row[j] : 0;
+		}
+	}
+}
+
+// c += sign a b for an MR by NR block of c, from a packed sliver of a and b
+// only the first m rows and n columns of the block are written back
+// the sums are separate variables so the compiler keeps them in registers
+static void micro_kernel(const int k, const double *a, const double *b,
+						 double *c, const int ldc, const double sign,
+						 const int m, const int n) {
+	Vec c0_lo = {}, c0_hi = {}, c1_lo = {}, c1_hi = {}, c2_lo = {}, c2_hi = {};
+	Vec c3_lo = {}, c3_hi = {}, c4_lo = {}, c4_hi = {}, c5_lo = {}, c5_hi = {};
+	for (int p = 0; p < k; ++p) {
+		const Vec b_lo = *reinterpret_cast<const Vec *>(b);
+		const Vec b_hi = *reinterpret_cast<const Vec *>(b + VEC_SIZE);
+		c0_lo += a[0] * b_lo;
+		c0_hi += a[0] * b_hi;
+		c1_lo += a[1] * b_lo;
+		c1_hi += a[1] * b_hi;
+		c2_lo += a[2] * b_lo;
+		c2_hi += a[2] * b_hi;
+		c3_lo += a[3] * b_lo;
+		c3_hi += a[3] * b_hi;
+		c4_lo += a[4] * b_lo;
+		c4_hi += a[4] * b_hi;
+		c5_lo += a[5] * b_lo;
+		c5_hi += a[5] * b_hi;
+		a += MR;
+		b += NR;
+	}
+	const Vec sums[MR][2] = {
+		{ c0_lo, c0_hi }, { c1_lo, c1_hi }, { c2_lo, c2_hi },
+		{ c3_lo, c3_hi }, { c4_lo, c4_hi }, { c5_lo, c5_hi }
+	};
+	if (m == MR && n == NR) {
+		for (int i = 0; i < MR; ++i) {
+			double *row = c + static_cast<std::ptrdiff_t>(i) * ldc;
+			*reinterpret_cast<Vec *>(row) += sign * sums[i][0];
+			*reinterpret_cast<Vec *>(row + VEC_SIZE) += sign * sums[i][1];
+		}
+		return;
+	}
+	for (int i = 0; i < m; ++i) {
+		double *row = c + static_cast<std::ptrdiff_t>(i) * ldc;
+		for (int j = 0; j < n; ++j)
+			row[j] += sign * sums[i][j / VEC_SIZE][j % VEC_SIZE];
+	}
+}
+
+// c += sign a b for an m by k a, a k by n b and an m by n c, on one thread
+// each block of b is packed once and used for every block of a
+static void multiply_serial(const int m, const int n, const int k,
+							const double *a, const int lda,
+							const double *b, const int ldb,
+							double *c, const int ldc, const double sign) {
+	std::vector<double> packed_a(MC * KC);
+	std::vector<double> packed_b(KC * NC);
+	for (int j0 = 0; j0 < n; j0 += NC) {
+		const int nc = std::min(NC, n - j0);
+		for (int p0 = 0; p0 < k; p0 += KC) {
+			const int kc = std::min(KC, k - p0);
+			pack_b(kc, nc, b + static_cast<std::ptrdiff_t>(p0) * ldb + j0,
+				   ldb, packed_b.data());
+			for (int i0 = 0; i0 < m; i0 += MC) {
+				const int mc = std::min(MC, m - i0);
+				pack_a(mc, kc, a + static_cast<std::ptrdiff_t>(i0) * lda + p0,
+					   lda, packed_a.data());
+				for (int j = 0; j < nc; j += NR) {
+					for (int i = 0; i < mc; i += MR) {
+						double *block = c + static_cast<std::ptrdiff_t>(i0 + i) * ldc
+										+ j0 + j;
+						micro_kernel(kc, packed_a.data() + i * kc,
+									 packed_b.data() + j * kc, block, ldc, sign,
+									 std::min(MR, mc - i), std::min(NR, nc - j));
+					}
+				}
+			}
+		}
+	}
+}
+
+// c += sign a b like multiply_serial(), splitting the rows of a and c
+// between threads, each thread packs its own blocks so they never wait
+static void multiply_blocked(const int m, const int n, const int k,
+							 const double *a, const int lda,
+							 const double *b, const int ldb,
+							 double *c, const int ldc, const double sign,
+							 int threads) {
+	const int slivers = (m + MR - 1) / MR;
+	threads = std::min(thread_count(threads), slivers);
+	if (static_cast<double>(m) * n * k < MIN_PARALLEL)
+		threads = 1;
+	if (threads <= 1) {
+		multiply_serial(m, n, k, a, lda, b, ldb, c, ldc, sign);
+		return;
+	}
+	// split on sliver boundaries
+	auto first_row = [m, slivers, threads](const int t) {
+		return std::min(m, slivers * t / threads * MR);
+	};
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t) {
+		const int begin = first_row(t);
+		workers.emplace_back(multiply_serial, first_row(t + 1) - begin, n, k,
+							 a + static_cast<std::ptrdiff_t>(begin) * lda, lda,
+							 b, ldb, c + static_cast<std::ptrdiff_t>(begin) * ldc,
+							 ldc, sign);
+	}
+	multiply_serial(first_row(1), n, k, a, lda, b, ldb, c, ldc, sign);
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+// result = a b
+const char *matrix_multiply(const Matrix &a, const Matrix &b, Matrix &result,
+							int threads) {
+	if (a.cols() != b.rows())
+		return "matrix size error";
+	result = Matrix(a.rows(), b.cols());
+	multiply_blocked(a.rows(), b.cols(), a.cols(), a.data(), a.cols(),
+					 b.data(), b.cols(), result.data(), result.cols(), 1,
+					 threads);
+	return entries_error(result);
+}
+
+//------------------------------inverse------------------------------
+
+// row -= factor other for count entries, simple enough to vectorise
+static void subtract_row(double *row, const double *other,
+						 const double factor, const int count) {
+	for (int c = 0; c < count; ++c)
+		row[c] -= factor * other[c];
+}
+
+// decomposes the n by n a in place into a unit lower L and an upper U with
+// P a = L U, where step j swapped row j with row pivots[j]
+// each panel of LU_BLOCK columns is factored on its own, then the rest of
+// the matrix is updated by a single product
+// returns false if a pivot is too small compared to max_entry, the biggest
+// entry of a, for the matrix to be told apart from a singular one
+static bool lu_decompose(const int n, double *a, std::vector<int> &pivots,
+						 const double max_entry, const int threads) {
+	auto row = [n, a](const int i) {
+		return a + static_cast<std::ptrdiff_t>(i) * n;
+	};
+	const double min_pivot = n * DBL_EPSILON * max_entry;
+	pivots.resize(n);
+	for (int j0 = 0; j0 < n; j0 += LU_BLOCK) {
+		const int j1 = std::min(n, j0 + LU_BLOCK);
+		// factor the panel of columns [j0, j1) with partial pivoting
+		for (int j = j0; j < j1; ++j) {
+			int pivot = j;
+			for (int i = j + 1; i < n; ++i) {
+				if (std::fabs(row(i)[j]) > std::fabs(row(pivot)[j]))
+					pivot = i;
+			}
+			if (std::fabs(row(pivot)[j]) <= min_pivot)
+				return false;
+			pivots[j] = pivot;
+			if (pivot != j)
+				std::swap_ranges(row(j), row(j) + n, row(pivot));
+			for (int i = j + 1; i < n; ++i) {
+				row(i)[j] /= row(j)[j];
+				subtract_row(row(i) + j + 1, row(j) + j + 1, row(i)[j],
+							 j1 - j - 1);
+			}
+		}
+		if (j1 == n)
+			break;
+		// the block of U right of the panel, solving with the panel's L
+		for (int i = j0 + 1; i < j1; ++i) {
+			for (int r = j0; r < i; ++r)
+				subtract_row(row(i) + j1, row(r) + j1, row(i)[r], n - j1);
+		}
+		// the rest of the matrix loses the product of the panel's L and U
+		multiply_blocked(n - j1, n - j1, j1 - j0, row(j1) + j0, n,
+						 row(j0) + j1, n, row(j1) + j1, n, -1, threads);
+	}
+	return true;
+}
+
+// solves L y = x in place for the n by n x, where L is the unit lower
+// triangle of lu, a block of rows at a time so most of the work is a product
+static void solve_lower(const int n, const double *lu, double *x,
+						const int threads) {
+	auto row = [n](const double *m, const int i) {
+		return m + static_cast<std::ptrdiff_t>(i) * n;
+	};
+	for (int i0 = 0; i0 < n; i0 += LU_BLOCK) {
+		const int i1 = std::min(n, i0 + LU_BLOCK);
+		double *block = x + static_cast<std::ptrdiff_t>(i0) * n;
+		if (i0 > 0)
+			multiply_blocked(i1 - i0, n, i0, row(lu, i0), n, x, n, block, n,
+							 -1, threads);
+		for (int i = i0 + 1; i < i1; ++i) {
+			for (int r = i0; r < i; ++r)
+				subtract_row(x + static_cast<std::ptrdiff_t>(i) * n,
+							 row(x, r), row(lu, i)[r], n);
+		}
+	}
+}
+
+// solves U y = x in place for the n by n x, where U is the upper triangle
+// of lu, a block of rows at a time from the bottom
+static void solve_upper(const int n, const double *lu, double *x,
+						const int threads) {
+	auto row = [n](const double *m, const int i) {
+		return m + static_cast<std::ptrdiff_t>(i) * n;
+	};
+	for (int i1 = n; i1 > 0; i1 -= LU_BLOCK) {
+		const int i0 = std::max(0, i1 - LU_BLOCK);
+		double *block = x + static_cast<std::ptrdiff_t>(i0) * n;
+		if (i1 < n)
+			multiply_blocked(i1 - i0, n, n - i1, row(lu, i0) + i1, n,
+							 row(x, i1), n, block, n, -1, threads);
+		for (int i = i1 - 1; i >= i0; --i) {
+			double *x_row = x + static_cast<std::ptrdiff_t>(i) * n;
+			for (int r = i + 1; r < i1; ++r)
+				subtract_row(x_row, row(x, r), row(lu, i)[r], n);
+			const double diagonal = row(lu, i)[i];
+			for (int c = 0; c < n; ++c)
+				x_row[c] /= diagonal;
+		}
+	}
+}
+
+// result = a^-1, from a blocked LU decomposition with partial pivoting
+// solves L U result = P, the identity with the pivots' row swaps
+const char *matrix_inverse(const Matrix &a, Matrix &result, int threads) {
+	if (a.rows() != a.cols())
+		return "square matrix error";
+	const int n = a.rows();
+	threads = thread_count(threads);
+	Matrix lu = a;
+	const double *entries = a.data();
+	double max_entry = 0;
+	for (std::size_t i = 0; i < static_cast<std::size_t>(n) * n; ++i)
+		max_entry = std::max(max_entry, std::fabs(entries[i]));
+	std::vector<int> pivots;
+	if (!lu_decompose(n, lu.data(), pivots, max_entry, threads))
+		return "divide by 0 error";
+
+	result = Matrix(n, n);
+	for (int i = 0; i < n; ++i)
+		result.at(i, i) = 1;
+	for (int j = 0; j < n; ++j) {
+		if (pivots[j] != j) {
+			std::swap_ranges(&result.at(j, 0), &result.at(j, 0) + n,
+							 &result.at(pivots[j], 0));
+		}
+	}
+	solve_lower(n, lu.data(), result.data(), threads);
+	solve_upper(n, lu.data(), result.data(), threads);
+	return entries_error(result);
+}
+
+//------------------------------parsing------------------------------
+
+// true for the characters that separate entries
+static bool is_separator(const char c) {
+	return std::isspace(static_cast<unsigned char>(c)) || c == ',';
+}
+
+// reads a matrix from [begin, end), one row per line with the entries
+// separated by spaces, tabs or commas, empty lines are skipped
+const char *parse_matrix(const char *begin, const char *end, Matrix &result) {
+	std::vector<double> values;
+	int rows = 0;
+	int cols = 0;
+	for (const char *line = begin; line < end; ) {
+		const char *line_end = std::find(line, end, '\n');
+		int count = 0;
+		const char *c = line;
+		while (true) {
+			while (c < line_end && is_separator(*c))
+				++c;
+			if (c == line_end)
+				break;
+			// from_chars doesn't take a plus sign
+			if (*c == '+')
+				++c;
+			double value;
+			auto parsed = std::from_chars(c, line_end, value);
+			if (parsed.ec != std::errc() ||
+				(parsed.ptr < line_end && !is_separator(*parsed.ptr))) {
+				return "matrix format error";
+			}
+			values.push_back(value);
+			++count;
+			c = parsed.ptr;
+		}
+		if (count > 0) {
+			if (rows == 0)
+				cols = count;
+			else if (count != cols)
+				return "row length error";
+			++rows;
+		}
+		line = line_end + 1;
+	}
+	if (rows == 0)
+		return "no data error";
+	result = Matrix(rows, cols);
+	std::copy(values.begin(), values.end(), result.data());
+	return nullptr;
+}
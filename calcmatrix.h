@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+// dense matrices for the matrix registers
+// multiplication packs blocks of both operands to fit the caches and runs a
+// register blocked kernel written with GCC vector types, so it compiles to
+// SIMD on any target, and big products are split across threads by rows
+
+// a dense row major matrix of doubles
+class Matrix {
+public:
+	Matrix(const int rows_in = 0, const int cols_in = 0);
+
+	int rows() const;
+	int cols() const;
+	bool is_empty() const;
+	double &at(const int row, const int col);
+	double at(const int row, const int col) const;
+	double *data();
+	const double *data() const;
+
+private:
+	int n_rows = 0;
+	int n_cols = 0;
+	std::vector<double> values;
+};
+
+// these return the error message for invalid inputs, or nullptr on success
+// all error messages contain the string "error" in them, like the calculator's
+// threads <= 0 uses one thread per core
+// result = a + b
+const char *matrix_add(const Matrix &a, const Matrix &b, Matrix &result);
+// result = a - b
+const char *matrix_subtract(const Matrix &a, const Matrix &b, Matrix &result);
+// result = a b
+const char *matrix_multiply(const Matrix &a, const Matrix &b, Matrix &result,
+							int threads = 0);
+// result = a^-1, from a blocked LU decomposition with partial pivoting
+// a singular matrix is a "divide by 0 error"
+const char *matrix_inverse(const Matrix &a, Matrix &result, int threads = 0);
+
+// reads a matrix from [begin, end), one row per line with the entries
+// separated by spaces, tabs or commas, empty lines are skipped
+const char *parse_matrix(const char *begin, const char *end, Matrix &result);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// the layout of the shared memory segment the calculator publishes its
+// state in, shared by the calculator and the reader library
+// the calculator is the only writer and never waits for readers: the state
+// is guarded by a seqlock that readers retry on, and recent events are kept
+// in a ring that readers follow with their own cursor
+// readers map the state read only, the one thing they write, the count of
+// readers waiting, is in a separate segment
+
+// the prefix of the POSIX shared memory names of the segments
+constexpr const char *CALC_SHM_NAME = "/calculator-state";
+// appended to a state segment's name for its waiters segment
+constexpr const char *CALC_SHM_WAITERS_SUFFIX = "-waiters";
+// the name of the segment of session in the calculator with process id pid,
+// session 0 uses CALC_SHM_NAME-pid and session n CALC_SHM_NAME-pid-(n + 1)
+// the process id keeps calculators running at once from sharing a name
+inline std::string calc_shm_name(const int pid, const int session = 0) {
+	std::string name = CALC_SHM_NAME + ("-" + std::to_string(pid));
+	if (session == 0)
+		return name;
+	return name + "-" + std::to_string(session + 1);
+}
+// the process id in the name of a calculator's state or waiters segment,
+// given without the leading '/' as /dev/shm lists it, 0 for other names
+inline long calc_shm_pid(const char *entry) {
+	const char *prefix = CALC_SHM_NAME + 1;
+	const size_t prefix_length = std::strlen(prefix);
+	if (std::strncmp(entry, prefix, prefix_length) != 0 
+		|| entry[prefix_length] != '-') {
+		return 0;
+	}
+	char *end = nullptr;
+	const long pid = std::strtol(entry + prefix_length + 1, &end, 10);
+	if (end == entry + prefix_length + 1 || (*end != '\0' && *end != '-'))
+		return 0;
+	return (pid > 0) ? pid : 0;
+}
+// "CALC", written last once the segment is set up
+constexpr uint32_t CALC_SHM_MAGIC = 0x43414c43;
+// changed whenever the layout changes
+constexpr uint32_t CALC_SHM_VERSION = 2;
+// the characters a published text holds, the same as a display
+constexpr int CALC_SHM_TEXT_LENGTH = 32;
+// how many recent events the ring keeps, a power of two
+constexpr int CALC_SHM_EVENTS = 256;
+
+// a utf-16 string, truncated to CALC_SHM_TEXT_LENGTH
+struct CalcShmText {
+	uint32_t length;
+	char16_t chars[CALC_SHM_TEXT_LENGTH];
+};
+
+// the published state, what a reader copies out of the segment
+struct CalcShmState {
+	CalcShmText upper;
+	CalcShmText lower;
+	CalcShmText memory1;
+	CalcShmText memory2;
+	// the pending binary op, '\0' if there is none
+	char binary_op;
+	bool has_error;
+	bool rpn_mode;
+	// set while a long calculation runs and the upper display shows progress
+	bool task_running;
+};
+
+struct CalcShmSegment {
+	uint32_t magic;
+	uint32_t version;
+	// odd while state is being written, readers retry a copy if it changed
+	// also the futex word readers wait on for the next publish
+	std::atomic<uint32_t> sequence;
+	// set once the calculator exits, a new one creates a new segment
+	std::atomic<uint32_t> closed;
+	CalcShmState state;
+	// how many events have been published, the ring holds the last
+	// CALC_SHM_EVENTS of them
+	std::atomic<uint64_t> event_count;
+	// event n is in events[n % CALC_SHM_EVENTS] as n << 8 | the event char,
+	// so a reader can tell a slot that has been overwritten
+	std::atomic<uint64_t> events[CALC_SHM_EVENTS];
+};
+
+// the segment readers write to, so they can't change the state
+struct CalcShmWaiters {
+	// readers waiting on sequence, the writer only wakes them if there are any
+	std::atomic<uint32_t> waiters;
+};
+
+// processes share the atomics, so they can't fall back to a lock
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "");
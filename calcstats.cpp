@@ -0,0 +1,278 @@
+#include "calcstats.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+static const double PI = 3.14159265358979323846;
+
+//------------------------------TDigest------------------------------
+
+TDigest::TDigest(const double compression_in) : compression(compression_in) {
+	centroids.reserve(2 * compression + 2);
+	buffer.reserve(buffer_limit());
+}
+
+void TDigest::add(const double value, const double weight) {
+	if (total_weight == 0) {
+		min = max = value;
+	} else {
+		min = std::min(min, value);
+		max = std::max(max, value);
+	}
+	total_weight += weight;
+	buffer.push_back({value, weight});
+	if (buffer.size() >= buffer_limit())
+		compress();
+}
+
+// compress() scales by total_weight, so the totals are updated first
+void TDigest::merge(const TDigest &other) {
+	if (other.total_weight == 0)
+		return;
+	if (total_weight == 0) {
+		min = other.min;
+		max = other.max;
+	} else {
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+	}
+	total_weight += other.total_weight;
+	// compressed once all of other is in, so it sees every value the total
+	// counts, not a part of them scaled as if it were the whole
+	buffer.insert(buffer.end(), other.centroids.begin(), 
+				  other.centroids.end());
+	buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+	if (buffer.size() >= buffer_limit())
+		compress();
+}
+
+// merges buffer into centroids
+// uses the k1 scale function, so a centroid can only grow while its
+// quantile range stays within one unit of k
+void TDigest::compress() {
+	if (buffer.empty())
+		return;
+	buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+	std::sort(buffer.begin(), buffer.end(),
+			  [](const Centroid &a, const Centroid &b) {
+				  return a.mean < b.mean;
+			  });
+	centroids.clear();
+
+	auto k_of_q = [this](double q) {
+		return compression / (2 * PI) * std::asin(2 * q - 1);
+	};
+	auto q_of_k = [this](double k) {
+		return (std::sin(k * 2 * PI / compression) + 1) / 2;
+	};
+	double weight_so_far = 0;
+	double q_limit = q_of_k(k_of_q(0) + 1) * total_weight;
+	Centroid cur = buffer.front();
+	for (std::size_t i = 1; i < buffer.size(); ++i) {
+		const Centroid &next = buffer[i];
+		if (weight_so_far + cur.weight + next.weight <= q_limit) {
+			cur.weight += next.weight;
+			cur.mean += (next.mean - cur.mean) * next.weight / cur.weight;
+		} else {
+			weight_so_far += cur.weight;
+			centroids.push_back(cur);
+			q_limit = q_of_k(k_of_q(weight_so_far / total_weight) + 1)
+					  * total_weight;
+			cur = next;
+		}
+	}
+	centroids.push_back(cur);
+	buffer.clear();
+}
+
+// returns the estimated value at quantile q in [0, 1], nan if empty
+// interpolates between centroid centres, and between min and max at the ends
+double TDigest::quantile(const double q) {
+	compress();
+	if (centroids.empty())
+		return NaN;
+	if (centroids.size() == 1 || q <= 0)
+		return (q <= 0) ? min : centroids.front().mean;
+	if (q >= 1)
+		return max;
+
+	double index = q * total_weight;
+	const Centroid &first = centroids.front();
+	if (index < first.weight / 2) {
+		return min + (first.mean - min) * index / (first.weight / 2);
+	}
+	double weight_so_far = first.weight / 2;
+	for (std::size_t i = 0; i + 1 < centroids.size(); ++i) {
+		const Centroid &a = centroids[i];
+		const Centroid &b = centroids[i + 1];
+		double gap = (a.weight + b.weight) / 2;
+		if (index < weight_so_far + gap) {
+			double t = (index - weight_so_far) / gap;
+			return a.mean + (b.mean - a.mean) * t;
+		}
+		weight_so_far += gap;
+	}
+	const Centroid &last = centroids.back();
+	double t = (index - weight_so_far) / (last.weight / 2);
+	return last.mean + (max - last.mean) * std::min(t, 1.0);
+}
+
+std::size_t TDigest::buffer_limit() const {
+	return 5 * compression;
+}
+
+//----------------------------StreamStats----------------------------
+
+void StreamStats::add(const double value) {
+	if (n == 0) {
+		cur_min = cur_max = value;
+	} else {
+		cur_min = std::min(cur_min, value);
+		cur_max = std::max(cur_max, value);
+	}
+	++n;
+	add_to_sum(value);
+	// Welford's update
+	double delta = value - cur_mean;
+	cur_mean += delta / n;
+	m2 += delta * (value - cur_mean);
+	digest.add(value);
+}
+
+// combines other into this as if all its values had been added here
+// the moments are combined with Chan's pairwise update
+void StreamStats::merge(const StreamStats &other) {
+	if (other.n == 0)
+		return;
+	if (n == 0) {
+		*this = other;
+		return;
+	}
+	long long new_n = n + other.n;
+	double delta = other.cur_mean - cur_mean;
+	cur_mean += delta * other.n / new_n;
+	m2 += other.m2 + delta * delta * n / new_n * other.n;
+	n = new_n;
+	add_to_sum(other.total);
+	add_to_sum(other.compensation);
+	cur_min = std::min(cur_min, other.cur_min);
+	cur_max = std::max(cur_max, other.cur_max);
+	digest.merge(other.digest);
+}
+
+// Neumaier's variant of Kahan summation, which also handles a value larger
+// in magnitude than the running total
+void StreamStats::add_to_sum(const double value) {
+	double t = total + value;
+	if (std::fabs(total) >= std::fabs(value))
+		compensation += (total - t) + value;
+	else
+		compensation += (value - t) + total;
+	total = t;
+}
+
+long long StreamStats::count() const {
+	return n;
+}
+
+double StreamStats::sum() const {
+	return total + compensation;
+}
+
+double StreamStats::mean() const {
+	return (n > 0) ? cur_mean : NaN;
+}
+
+double StreamStats::min() const {
+	return (n > 0) ? cur_min : NaN;
+}
+
+double StreamStats::max() const {
+	return (n > 0) ? cur_max : NaN;
+}
+
+double StreamStats::variance() const {
+	return (n > 1) ? m2 / (n - 1) : NaN;
+}
+
+double StreamStats::std_dev() const {
+	return std::sqrt(variance());
+}
+
+double StreamStats::quantile(const double q) {
+	return digest.quantile(q);
+}
+
+//---------------------------reduce_column---------------------------
+
+// reduces every line in [begin, end) into result
+static void reduce_lines(const char *begin, const char *end,
+						 ColumnStats &result) {
+	const char *line = begin;
+	while (line < end) {
+		const char *line_end = std::find(line, end, '\n');
+		const char *first = line;
+		const char *last = line_end;
+		// trim whitespace, a leading '+' and a trailing ',' from pasted tables
+		while (first < last && std::isspace((unsigned char)*first))
+			++first;
+		while (last > first && (std::isspace((unsigned char)last[-1]) ||
+								last[-1] == ','))
+			--last;
+		if (first < last && *first == '+')
+			++first;
+		if (first < last) {
+			double value;
+			auto parsed = std::from_chars(first, last, value);
+			// from_chars also reads nan and inf, which would poison the
+			// sums and break sorting the digest
+			if (parsed.ec == std::errc() && parsed.ptr == last &&
+				std::isfinite(value))
+				result.stats.add(value);
+			else
+				++result.bad_lines;
+		}
+		line = line_end + 1;
+	}
+}
+
+// reads one number per line from [begin, end) and reduces them
+ColumnStats reduce_column(const char *begin, const char *end, int threads) {
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	// don't bother splitting small inputs
+	const std::ptrdiff_t MIN_CHUNK = 1 << 20;
+	threads = std::max(1, std::min<int>(threads, (end - begin) / MIN_CHUNK));
+
+	// split on line boundaries
+	std::vector<const char *> bounds = { begin };
+	for (int i = 1; i < threads; ++i) {
+		const char *pos = begin + (end - begin) * i / threads;
+		pos = std::find(std::max(pos, bounds.back()), end, '\n');
+		bounds.push_back(pos == end ? end : pos + 1);
+	}
+	bounds.push_back(end);
+
+	std::vector<ColumnStats> partials(threads);
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; ++i) {
+		workers.emplace_back(reduce_lines, bounds[i], bounds[i + 1],
+							 std::ref(partials[i]));
+	}
+	reduce_lines(bounds[0], bounds[1], partials[0]);
+	for (std::thread &worker : workers)
+		worker.join();
+
+	ColumnStats result = partials[0];
+	for (int i = 1; i < threads; ++i) {
+		result.stats.merge(partials[i].stats);
+		result.bad_lines += partials[i].bad_lines;
+	}
+	return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// streaming reducers for the statistics panel
+// every reducer uses constant memory no matter how many values are added,
+// and two reducers of the same kind can be merged so a data set can be split
+// across threads and combined afterwards
+
+// estimates quantiles with a merging t-digest
+// values are buffered, then sorted and merged into at most about compression
+// centroids, keeping the centroids small near the tails where accuracy matters
+class TDigest {
+public:
+	TDigest(const double compression_in = 100);
+
+	void add(const double value, const double weight = 1);
+	void merge(const TDigest &other);
+	// returns the estimated value at quantile q in [0, 1], nan if empty
+	double quantile(const double q);
+
+private:
+	struct Centroid {
+		double mean;
+		double weight;
+	};
+	double compression;
+	// sorted and compressed centroids
+	std::vector<Centroid> centroids;
+	// unsorted values waiting to be merged into centroids
+	std::vector<Centroid> buffer;
+	double total_weight = 0;
+	double min = 0;
+	double max = 0;
+
+	// merges buffer into centroids
+	void compress();
+	std::size_t buffer_limit() const;
+};
+
+// count, compensated sum, mean, variance, min, max and quantiles
+class StreamStats {
+public:
+	void add(const double value);
+	// combines other into this as if all its values had been added here
+	void merge(const StreamStats &other);
+
+	long long count() const;
+	// the Kahan-Neumaier compensated sum
+	double sum() const;
+	// these return nan if no values have been added
+	double mean() const;
+	double min() const;
+	double max() const;
+	// the sample variance, nan if there are fewer than two values
+	double variance() const;
+	double std_dev() const;
+	double quantile(const double q);
+
+private:
+	long long n = 0;
+	// Neumaier sum and its running compensation
+	double total = 0;
+	double compensation = 0;
+	// Welford mean and sum of squared differences from the mean
+	double cur_mean = 0;
+	double m2 = 0;
+	double cur_min = 0;
+	double cur_max = 0;
+	TDigest digest;
+
+	void add_to_sum(const double value);
+};
+
+// the result of reducing a column of text
+struct ColumnStats {
+	StreamStats stats;
+	// lines that weren't empty but couldn't be read as a finite number
+	long long bad_lines = 0;
+};
+
+// reads one number per line from [begin, end) and reduces them
+// the text is split on line boundaries into one chunk per thread,
+// each chunk is reduced separately and the results are merged
+// threads <= 0 uses one thread per core
+ColumnStats reduce_column(const char *begin, const char *end,
+						  int threads = 0);
@@ -2,28 +2,32 @@
 #include "calclabel.h"
 #include "calcbutton.h"
 
+#include <QCoreApplication>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
-#include <QMap>
+#include <QInputDialog>
 
+#include <algorithm>
+#include <climits>
 #include <cmath>
-
-// for debugging
-#include <QTextStream>
-static QTextStream out(stdout);
+#include <cstring>
 
 //----------------------------constructor----------------------------
 
 // initializes variables and displays, adds buttons, sets the layout
-Calculator::Calculator(QWidget *parent) : QWidget(parent) {	
+// nothing is shared between sessions, so each can calculate on its own
+Calculator::Calculator(const int session, QWidget *parent) 
+: QWidget(parent), 
+  state_export(calc_shm_name(int(QCoreApplication::applicationPid()), 
+							 session)) {	
 	// set keyboard focus
 	setFocusPolicy(Qt::StrongFocus);
 	
 	//----------------------display widgets------------------------
 	
-	upper_display = new CalcLabel(true, this);
-	lower_display = new CalcLabel(true, this);
+	upper_display = new CalcDisplay(this);
+	lower_display = new CalcDisplay(this);
 	binary_display = new CalcLabel(false, this);
 	clear_displays();
 	
@@ -36,6 +40,22 @@ Calculator::Calculator(QWidget *parent) : QWidget(parent) {
 	mem1_state->setAutoExclusive(false);
 	mem2_state->setAutoExclusive(false);
 	
+	stats_panel = new StatsPanel(this);
+	graph_panel = new GraphPanel(this);
+	history_panel = new HistoryPanel(this);
+	matrix_panel = new MatrixPanel(this);
+	event_frames.reserve(FRAME_CHUNK);
+	frame_events.reserve(FRAME_CHUNK * FRAME_EVENTS);
+	push_frame(u"0");
+	
+	task_timer = new QTimer(this);
+	task_timer->setInterval(16);
+	connect(task_timer, SIGNAL(timeout()), this, SLOT(poll_task()));
+	// runs whenever the event loop is idle
+	replay_timer = new QTimer(this);
+	replay_timer->setInterval(0);
+	connect(replay_timer, SIGNAL(timeout()), this, SLOT(replay_step()));
+	
 	QGridLayout *displays = new QGridLayout;
 	displays->addWidget(mem1_state, 0, 0);
 	displays->addWidget(mem2_state, 0, 1);
@@ -82,6 +102,11 @@ Calculator::Calculator(QWidget *parent) : QWidget(parent) {
 	buttons->addWidget(new CalcButton("1/x", 'i', this), 5, 1);
 	buttons->addWidget(new CalcButton("x!", '!', this), 5, 2);
 	buttons->addWidget(new CalcButton("=", 'q', this), 5, 3, 1, 2);
+	// row 7, equals is enter in RPN mode
+	buttons->addWidget(new CalcButton("RPN", 'o', this), 6, 0);
+	buttons->addWidget(new CalcButton("drop", 'j', this), 6, 1);
+	buttons->addWidget(new CalcButton("x↔y", 'y', this), 6, 2);
+	buttons->addWidget(new CalcButton("roll", 'b', this), 6, 3, 1, 2);
 	
 	//-----------------------overall layout------------------------
 	QLabel *hline = new QLabel(this);
@@ -96,11 +121,16 @@ Calculator::Calculator(QWidget *parent) : QWidget(parent) {
 	vbox->addLayout(buttons);
 	vbox->setSizeConstraint(QLayout::SetFixedSize);
 	setLayout(vbox);
+	publish_state('\0');
 }
 
 //----------------------------destructor-----------------------------
 
 Calculator::~Calculator() {
+	if (task_running) {
+		task_cancelled = true;
+		task_thread.join();
+	}
 	print_all_events();
 }
 
@@ -116,22 +146,77 @@ QString Calculator::get_lower_text() {
 }
 
 QString Calculator::get_memory1() {
-	return memory1;
+	return memory1.to_string();
 }
 
 QString Calculator::get_memory2() {
-	return memory2;
+	return memory2.to_string();
 }
 
 char Calculator::get_binary_op() {
 	return cur_binary_op;
 }
 
+// how often ^ and l results were found in the result cache
+CacheCounters Calculator::get_cache_counters() {
+	return result_cache.counters();
+}
+
+// the event frames, for the history panel
+int Calculator::get_frame_count() {
+	return int(event_frames.size());
+}
+
+QString Calculator::get_frame_value(const int index) {
+	return event_frames.at(index).value.to_string();
+}
+
+// valid until the next event
+std::string_view Calculator::get_frame_events(const int index) {
+	const size_t begin = event_frames.at(index).events_begin;
+	if (index + 1 == int(event_frames.size()))
+		return std::string_view(frame_events).substr(begin);
+	return std::string_view(frame_events).substr(
+		begin, event_frames[index + 1].events_begin - begin);
+}
+
+// puts value in the active display as an undoable event, like a memory
+// ignored while a task or a replay runs, since the value isn't queued with
+// the event
+void Calculator::recall_value(const QString &value) {
+	if (task_running || replay_running())
+		return;
+	recalled_value = value;
+	do_event('v', true);
+}
+
 //-----------------------------do_event------------------------------
 
 // calls an input function based on event, also calls add_event()
 // returns whether the event was recognized by the switch statement
+// while a task or a replay runs, 'c' cancels it and other events are
+// queued, except the events the replay itself runs
 bool Calculator::do_event(const char event, bool add_this_event) {
+	if ((task_running || replay_running()) && !replaying_event 
+		&& event != '\0') {
+		if (event == 'c') {
+			if (task_running)
+				cancel_task();
+			if (replay_running())
+				cancel_replay();
+			publish_state(event);
+		} else {
+			queued_events.append({ event, add_this_event });
+		}
+		return true;
+	}
+	// RPN mode has its own inputs and undo, only the panels are shared
+	if (rpn_mode && event != 'o' && event != 'h' && event != '#') {
+		if (!do_rpn_event(event))
+			return false;
+		publish_state(event);
+		return true;
+	}
 	try {
 		switch (event) {
 			case '0' ... '9':
@@ -162,6 +247,33 @@ bool Calculator::do_event(const char event, bool add_this_event) {
 			case 's':
 				on_sign();
 				break;
+			case 'a':
+				on_stat_add();
+				break;
+			case 'h':
+				on_history();
+				break;
+			case '#':
+				on_matrix();
+				break;
+			case 'v':
+				on_recall();
+				break;
+			case 'k':
+				on_record();
+				break;
+			case 'p':
+				on_play();
+				break;
+			case 't':
+				on_repeat();
+				break;
+			case 'g':
+				on_graph();
+				break;
+			case 'o':
+				on_rpn_mode();
+				break;
 			case 'q':
 				on_equals();
 				break;
@@ -178,21 +290,30 @@ bool Calculator::do_event(const char event, bool add_this_event) {
 	catch (const BadStateError &error) {
 		add_this_event = false;
 	}
-	if (add_this_event)
+	if (add_this_event) {
 		add_event(event);
+		if (recording_macro)
+			record_event(event);
+	}
+	// events replayed by undo aren't new, so only their state is published
+	publish_state(add_this_event ? event : '\0');
 	return true;
 }
 
+// converts the first character of a key's text to an event char
+static char text_to_event(const QString &text) {
+	if (text.isEmpty())
+		return '\0';
+	char event_char = text[0].toLatin1();
+	if (event_char == 'M') // necessary because 'm' and 'M' are different
+		return event_char;
+	return (event_char >= 'A' && event_char <= 'Z') ? event_char - 'A' + 'a' 
+													: event_char;
+}
+
 // sends key presses to do_event(), passes on to QWidget if not recognized
 void Calculator::keyPressEvent(QKeyEvent *event) {
-	// convert from text to char
-	QChar intermediate;
-	if (!event->text().isEmpty())
-		intermediate = event->text()[0];
-	if (intermediate != 'M') // necessary because 'm' and 'M' are different
-		intermediate = intermediate.toLower();
-	char event_char = intermediate.toLatin1();
-	
+	char event_char;
 	// handle keys different from the event chars
 	switch (event->key()) {
 		// functions
@@ -237,6 +358,9 @@ void Calculator::keyPressEvent(QKeyEvent *event) {
 		case Qt::Key_F:
 			event_char = '!';
 			break;
+			// everything else is converted from text to char
+		default:
+			event_char = text_to_event(event->text());
 	}
 	bool key_recognized = do_event(event_char, true);
 	if (!key_recognized)
@@ -248,50 +372,54 @@ void Calculator::keyPressEvent(QKeyEvent *event) {
 // adds a digit to the active display, also handles decimal points
 // will replace the current display if overwrite is set
 void Calculator::on_digit(const char digit) {
-	QString active_str = active_display->text();
-	if (digit == '0' && active_str == "0")
+	DisplayText active_str = active_display->view();
+	bool clears_error = overwrite_on_input;
+	if (!edit_digit(active_str, overwrite_on_input, digit))
 		throw BadStateError();
-	
-	// handle overwriting the display
-	if (overwrite_on_input) {
-		overwrite_on_input = (digit == '0');
+	if (clears_error)
 		active_has_error = false;
-		active_str = (digit == '.') ? "0" : "";
-	} else {
-		if (at_max_precision(active_str))
-			throw BadStateError();
-		if ((digit == '0') && 
-			(active_str.endsWith("e+") || active_str.endsWith("e-"))) {
-			throw BadStateError();
-		} else if ((digit == '.') && 
-			(active_str.contains(".") || active_str.contains("e"))) {
-			throw BadStateError();
-		}
+	active_display->setText(active_str);
+}
+
+// maps binary event chars to their visual string representation
+// the strings are literals in read only data, so setting the binary display
+// never allocates and sessions share nothing they can write
+static QString binary_display_string(const char binary_op) {
+	switch (binary_op) {
+		case '+':
+			return QStringLiteral("+");
+		case '-':
+			return QStringLiteral("−");
+		case 'x':
+			return QStringLiteral("×");
+		case 'd':
+			return QStringLiteral("÷");
+		case '^':
+			return QStringLiteral("^");
+		case 'l':
+			return QStringLiteral("log");
+		case 'm':
+			return QStringLiteral("mod");
 	}
-	active_display->setText(active_str + digit);
+	return QString();
 }
 
 // changes the current binary op to the pressed one, does no calculations
 // sets the active display to lower display, initializes it if not set
 // initializing the lower display triggers overwrite
 void Calculator::on_binary(const char binary_op) {
-	// maps binary event chars to their visual string representation
-	static const QMap<char, QString> display_strings = { 
-		{'+', "+"}, {'-', "−"}, {'x', "×"}, {'d', "÷"}, {'^', "^"}, 
-		{'l', "log"}, {'m', "mod"}
-	};
 	if (active_has_error)
 		throw BadStateError();
-	QString display_str = display_strings.value(binary_op);
-	if (display_str == binary_display->text())
+	// the binary display is only set while lower is active
+	if (active_display == lower_display && binary_op == cur_binary_op)
 		throw BadStateError();
-	binary_display->setText(display_str);
+	binary_display->setText(binary_display_string(binary_op));
 	cur_binary_op = binary_op;
 	
 	if (active_display == upper_display) {
 		active_display = lower_display;
 		overwrite_on_input = true;
-		lower_display->setText("0");
+		lower_display->setText(u"0");
 	}
 }
 
@@ -301,18 +429,9 @@ void Calculator::on_binary(const char binary_op) {
 void Calculator::on_unary(const char unary_op) {
 	if (active_has_error)
 		throw BadStateError();
-	QString new_value;
-	try {
-		double value = string_to_double(active_display->text());
-		check_unary_error(unary_op, value);
-		value = calculate_unary(unary_op, value);
-		new_value = double_to_string(value);
-		check_number_error(new_value);
-	}
-	catch (const QString &error_message) {
+	DisplayText new_value = active_display->view();
+	if (unary_result(unary_op, new_value))
 		active_has_error = true;
-		new_value = error_message;
-	}
 	overwrite_on_input = true;
 	active_display->setText(new_value);
 }
@@ -320,12 +439,12 @@ void Calculator::on_unary(const char unary_op) {
 // either writes memory to the display or reads the display value into memory
 // writing to the display triggers overwrite
 void Calculator::on_memory(const char mem) {
-	QString &mem_str = (mem == 'M') ? memory1 : memory2;
-	QString active_str = active_display->text();
+	DisplayText &mem_str = (mem == 'M') ? memory1 : memory2;
+	QStringView active_str = active_display->view();
 	
-	if (active_str != "0" && !active_has_error) {
+	if (active_str != u"0" && !active_has_error) {
 		mem_str = active_str;
-	} else if (!mem_str.isEmpty()) {
+	} else if (!mem_str.is_empty()) {
 		overwrite_on_input = true;
 		active_has_error = false;
 		active_display->setText(mem_str);
@@ -340,15 +459,10 @@ void Calculator::on_memory(const char mem) {
 void Calculator::on_scientific() {
 	if (active_has_error)
 		throw BadStateError();
-	QString active_str = active_display->text();
-	if (active_str.contains("e") || 
-		string_to_double(active_str) == 0.0) {
+	DisplayText active_str = active_display->view();
+	if (!edit_scientific(active_str, overwrite_on_input))
 		throw BadStateError();
-	}
-	// scientific has a unique overwrite reaction
-	// it allows a number to append a new exponent even if it was calculated
-	overwrite_on_input = false;
-	active_display->setText(active_str + "e+");
+	active_display->setText(active_str);
 }
 
 // swaps the sign of the number or if the number has e, the sign of e
@@ -356,48 +470,75 @@ void Calculator::on_scientific() {
 void Calculator::on_sign() {
 	if (active_has_error) 
 		throw BadStateError();
-	QString active_str = active_display->text();
-	if (active_str == "0")
+	DisplayText active_str = active_display->view();
+	if (!edit_sign(active_str))
 		throw BadStateError();
-	
-	if (active_str.contains("e+"))
-		active_str.replace("e+", "e-");
-	else if (active_str.contains("e-"))
-		active_str.replace("e-", "e+");
-	else if (active_str.startsWith("-"))
-		active_str.remove(0, 1);
-	else
-		active_str.prepend("-");
-	
 	active_display->setText(active_str);
 }
 
+// adds the active display value to the statistics data set
+// doesn't change the calculator state, so it isn't recorded for undo
+void Calculator::on_stat_add() {
+	if (active_has_error)
+		throw BadStateError();
+	stats_panel->add_value(string_to_double(active_display->view()));
+	stats_panel->show();
+}
+
+// shows the history panel
+void Calculator::on_history() {
+	history_panel->show();
+	history_panel->raise();
+}
+
+// shows the matrix panel
+void Calculator::on_matrix() {
+	matrix_panel->show();
+	matrix_panel->raise();
+}
+
+// writes recalled_value to the active display, triggers overwrite
+// error values can't be recalled
+void Calculator::on_recall() {
+	QString value;
+	value.swap(recalled_value);
+	if (value.isEmpty() || value.contains("error"))
+		throw BadStateError();
+	overwrite_on_input = true;
+	active_has_error = false;
+	active_display->setText(value);
+}
+
 //-------------------------functional inputs-------------------------
 
-// either recalculates the upper display, or does the binary calculation
+// does the binary calculation, repeats the last one if lower isn't set,
+// or recalculates the upper display if there is nothing to repeat
 // clears the display and places the value in the upper display
 // triggers overwrite, can trigger active_has_error
 void Calculator::on_equals() {
 	if (active_has_error)
 		throw BadStateError();
-	QString new_value;
-	try {
-		double up, lo, value;
-		// either recalculate the upper value or attempt the binary calculation
-		value = string_to_double(upper_display->text());
-		QString lo_str = lower_display->text();
-		if (!lo_str.isEmpty()) {
-			up = value;
-			lo = string_to_double(lo_str);
-			check_binary_error(up, lo);
-			value = calculate_binary(up, lo);
-		}
-		new_value = double_to_string(value);
-		check_number_error(new_value);
-	}
-	catch (const QString &error_message) {
+	DisplayText new_value;
+	// the frame's repeat carries over when there's nothing to repeat
+	equals_repeat = current_frame().repeat;
+	QStringView lower_str = lower_display->view();
+	const char binary_op = lower_str.isEmpty() ? equals_repeat.op 
+											   : cur_binary_op;
+	if (ResultCache::caches(binary_op)) {
+		// the same as equals_result(), through the result cache
+		if (!lower_str.isEmpty())
+			equals_repeat = { binary_op, string_to_double(lower_str) };
+		CachedResult result;
+		binary_result(binary_op, string_to_double(upper_display->view()), 
+					  equals_repeat.operand, true, result);
+		new_value = result.text;
+		if (result.error)
+			active_has_error = true;
+	} else if (equals_result(upper_display->view(), lower_str, 
+							 cur_binary_op, equals_repeat.op, 
+							 equals_repeat.operand, &precision_counters, 
+							 new_value)) {
 		active_has_error = true;
-		new_value = error_message;
 	}
 	print_state();
 	clear_displays(new_value);
@@ -412,38 +553,834 @@ void Calculator::on_clear() {
 
 // returns the calculator to the previous state before the most recent event
 void Calculator::on_undo() {
-	QString &recent_events = event_frames.last().second;
 	// remove the last event
-	if (recent_events.isEmpty()) {
+	if (current_events().empty()) {
 		if (event_frames.size() > 1)
 			event_frames.pop_back();
 	} else {
-		char last_event = recent_events.back().toLatin1();
-		remove_old_values(last_event);
-		recent_events.chop(1);
+		remove_old_values(frame_events.back());
+		frame_events.pop_back();
 	}
 	reset_state();
+	history_panel->frames_changed(get_frame_count() - 1);
+}
+
+//------------------------------macros-------------------------------
+
+// starts recording events, or stops and saves them as a named macro
+void Calculator::on_record() {
+	if (!recording_macro) {
+		recording_macro = true;
+		recorded_events.clear();
+		setWindowTitle(windowTitle() + RECORDING_TITLE);
+		return;
+	}
+	recording_macro = false;
+	setWindowTitle(windowTitle().remove(RECORDING_TITLE));
+	// a replayed repeat would open its dialog every time
+	recorded_events.remove(QLatin1Char('t'));
+	if (recorded_events.isEmpty())
+		return;
+	
+	bool ok = false;
+	QString name = QInputDialog::getText(this, "save macro", "name:", 
+										 QLineEdit::Normal, 
+										 QString("macro %1").arg(macros.size() + 1),
+										 &ok);
+	if (!ok || name.isEmpty())
+		return;
+	Macro macro;
+	macro.events = recorded_events;
+	macro.compiled = compile_macro(macro);
+	macros.insert(name, macro);
+}
+
+// asks for a macro and a repeat count, then plays it
+// compiled macros run on the upper value and add a single event frame,
+// other macros replay their events through do_event(), in chunks
+void Calculator::on_play() {
+	if (recording_macro || macros.isEmpty())
+		throw BadStateError();
+	bool ok = false;
+	QString name = QInputDialog::getItem(this, "play macro", "macro:", 
+										 macros.keys(), 0, false, &ok);
+	if (!ok)
+		throw BadStateError();
+	int count = QInputDialog::getInt(this, "play macro", "repeat count:", 
+									 1, 1, INT_MAX, 1, &ok);
+	if (!ok)
+		throw BadStateError();
+	
+	const Macro &macro = macros[name];
+	if (macro.compiled) {
+		if (active_display != upper_display || active_has_error)
+			throw BadStateError();
+		run_compiled_macro(macro, count);
+	} else {
+		start_replay(macro.events, count);
+	}
+}
+
+// appends a recorded event to recorded_events, undo removes the last one
+// adding to the statistics isn't recorded, so it can't stop a macro from
+// compiling, repeats are recorded for undo but dropped when saving
+void Calculator::record_event(const char event) {
+	switch (event) {
+		case 'k':
+		case 'p':
+		case 'g':
+		case 'h':
+		case '#':
+		case 'v':
+		case 'a':
+			return;
+		case 'u':
+			recorded_events.chop(1);
+			return;
+	}
+	recorded_events += QLatin1Char(event);
+}
+
+// turns the events of macro into steps, returns false if it can't
+// a macro compiles if each equals applies a typed number to the upper value,
+// and unary ops only apply to the upper value
+// the typed numbers are read once here, using the same editing rules
+bool Calculator::compile_macro(Macro &macro) {
+	macro.steps.clear();
+	// set while the lower display would be active
+	char binary_op = '\0';
+	DisplayText lower;
+	bool lower_overwrite = true;
+	
+	for (QChar event_char : macro.events) {
+		char event = event_char.toLatin1();
+		// edits that aren't allowed are ignored, just like in do_event()
+		switch (event) {
+			case '0' ... '9':
+			case '.':
+				if (binary_op == '\0')
+					return false; // typing over the upper value
+				edit_digit(lower, lower_overwrite, event);
+				break;
+			case 'e':
+				if (binary_op == '\0')
+					return false;
+				edit_scientific(lower, lower_overwrite);
+				break;
+			case 's':
+				if (binary_op == '\0')
+					return false;
+				edit_sign(lower);
+				break;
+			case '+':
+			case '-':
+			case 'x':
+			case 'd':
+			case '^':
+			case 'l':
+			case 'm':
+				if (binary_op == '\0') {
+					lower = u"0";
+					lower_overwrite = true;
+				}
+				binary_op = event;
+				break;
+			case 'r':
+			case 'i':
+			case '!':
+				if (binary_op != '\0')
+					return false; // a unary op on the typed number
+				macro.steps.append({ event, 0 });
+				break;
+			case 'q':
+				if (binary_op == '\0') {
+					// repeats whatever op is being repeated when it runs
+					macro.steps.append({ 'q', 0 });
+				} else {
+					macro.steps.append({ binary_op, string_to_double(lower) });
+					binary_op = '\0';
+				}
+				break;
+			default:
+				return false;
+		}
+	}
+	// a macro that leaves an operation pending can't be compiled
+	return binary_op == '\0';
+}
+
+// runs the compiled steps count times on the upper value
+// each step is rounded like a display would round it, so the result matches
+// replaying the events, but the displays are only updated once at the end
+// stops at the first error, and adds a single event frame for undo
+// long runs are a task, so they don't freeze the window
+void Calculator::run_compiled_macro(const Macro &macro, const int count) {
+	const double start = string_to_double(upper_display->view());
+	const QVector<CalcStep> steps = macro.steps;
+	auto work = [this, start, steps, count](Repeat &repeat) {
+		double value = start;
+		for (int i = 0; i < count; ++i) {
+			check_task(i, count);
+			for (const CalcStep &step : steps) {
+				switch (step.op) {
+					case 'q':
+						if (repeat.op == '\0')
+							break;
+						value = binary_step(repeat.op, value, repeat.operand);
+						break;
+					case 'r':
+					case 'i':
+					case '!':
+						check_unary_error(step.op, value);
+						value = calculate_unary(step.op, value);
+						break;
+					default:
+						value = binary_step(step.op, value, step.operand);
+						repeat = { step.op, step.operand };
+				}
+				value = round_to_display(value);
+			}
+		}
+		return value;
+	};
+	run_task(work, current_frame().repeat, (long long)count * steps.size());
+}
+
+// asks for a compiled macro and plots it as a function of the upper value
+// equals without a lower value repeats the current frame's op, as it would
+// if the macro were played now
+void Calculator::on_graph() {
+	QStringList names;
+	for (auto it = macros.cbegin(); it != macros.cend(); ++it) {
+		if (it.value().compiled)
+			names.append(it.key());
+	}
+	if (recording_macro || names.isEmpty())
+		throw BadStateError();
+	bool ok = false;
+	QString name = QInputDialog::getItem(this, "graph macro", "macro:", 
+										 names, 0, false, &ok);
+	if (!ok)
+		throw BadStateError();
+	
+	QVector<CalcStep> steps;
+	Repeat repeat = current_frame().repeat;
+	for (const CalcStep &step : macros[name].steps) {
+		switch (step.op) {
+			case 'q':
+				if (repeat.op != '\0')
+					steps.append({ repeat.op, repeat.operand });
+				break;
+			case 'r':
+			case 'i':
+			case '!':
+				steps.append(step);
+				break;
+			default:
+				steps.append(step);
+				repeat = { step.op, step.operand };
+		}
+	}
+	graph_panel->plot(name, steps);
+	graph_panel->show();
+	graph_panel->raise();
+}
+
+//------------------------------repeats------------------------------
+
+// a double with a separate wide exponent, so a product of many factors
+// can't overflow or underflow before the final result is known
+struct WideDouble {
+	// 0 or in [0.5, 1) in magnitude
+	double mantissa;
+	long long exponent;
+};
+
+static WideDouble to_wide(const double value) {
+	int exponent;
+	double mantissa = std::frexp(value, &exponent);
+	return { mantissa, exponent };
+}
+
+static WideDouble wide_multiply(const WideDouble &a, const WideDouble &b) {
+	WideDouble product = to_wide(a.mantissa * b.mantissa);
+	product.exponent += a.exponent + b.exponent;
+	return product;
+}
+
+static WideDouble wide_divide(const WideDouble &a, const WideDouble &b) {
+	WideDouble quotient = to_wide(a.mantissa / b.mantissa);
+	quotient.exponent += a.exponent - b.exponent;
+	return quotient;
+}
+
+// base to the power of count by squaring, count >= 0
+static WideDouble wide_pow(WideDouble base, long long count) {
+	WideDouble result = to_wide(1);
+	while (count > 0) {
+		if (count & 1)
+			result = wide_multiply(result, base);
+		base = wide_multiply(base, base);
+		count >>= 1;
+	}
+	return result;
+}
+
+// returns inf or 0 if the exponent is out of range for a double
+static double from_wide(const WideDouble &value) {
+	if (value.mantissa == 0 || value.exponent < -2000)
+		return std::copysign(0.0, value.mantissa);
+	if (value.exponent > 2000)
+		return std::copysign(INFINITY, value.mantissa);
+	return std::ldexp(value.mantissa, value.exponent);
+}
+
+// asks for a count, then applies the op equals would repeat that many times
+// if the lower display is set, its op is repeated instead, like equals would
+// the result is exact rather than rounded for the display after every step
+// clears the display like equals, adding a single event frame for undo
+// repeats without a closed form are a task when the count is large
+void Calculator::on_repeat() {
+	if (active_has_error)
+		throw BadStateError();
+	Repeat repeat = current_frame().repeat;
+	QStringView lo_str = lower_display->view();
+	if (!lo_str.isEmpty()) {
+		repeat.op = cur_binary_op;
+		repeat.operand = string_to_double(lo_str);
+	}
+	if (repeat.op == '\0')
+		throw BadStateError();
+	bool ok = false;
+	int count = QInputDialog::getInt(this, "repeat", "repeat count:", 
+									 2, 1, INT_MAX, 1, &ok);
+	if (!ok)
+		throw BadStateError();
+	
+	const double start = string_to_double(upper_display->view());
+	auto work = [this, start, count](Repeat &repeat) {
+		return repeat_binary(repeat.op, start, repeat.operand, count);
+	};
+	// the closed forms in repeat_binary() cost the same for any count
+	bool closed_form = std::strchr("+-xd", repeat.op) 
+					   || (repeat.op == '^' && start > 0);
+	run_task(work, repeat, closed_form ? 1 : count);
+}
+
+// returns binary_op applied count times, each time with lo and the last result
+// uses closed forms where possible: up + lo*count for + and -, up * lo^count
+// by squaring for x and d, and up^(lo^count) for a tower of positive powers
+// log, mod and other powers are applied step by step until they settle
+// throws the error an equals at the failing step would have shown
+double Calculator::repeat_binary(const char binary_op, const double up,
+								 const double lo, const int count) {
+	// errors that don't depend on up are found by the first step
+	check_binary_error(binary_op, up, lo);
+	switch (binary_op) {
+		case '+':
+			return up + lo * count;
+		case '-':
+			return up - lo * count;
+		case 'x':
+			return from_wide(wide_multiply(to_wide(up), 
+										   wide_pow(to_wide(lo), count)));
+		case 'd':
+			return from_wide(wide_divide(to_wide(up), 
+										 wide_pow(to_wide(lo), count)));
+		case '^':
+			if (up > 0)
+				return repeat_power(up, lo, count);
+			break;
+	}
+	return repeat_steps(binary_op, up, lo, count);
+}
+
+// returns ((up^lo)^lo)... count times, which is up^(lo^count) for up > 0
+// a tower of negative powers can swing between huge and tiny values,
+// so the step before the last is checked for overflow as well
+double Calculator::repeat_power(const double up, const double lo, 
+								const int count) {
+	if (count == 1)
+		return std::pow(up, lo);
+	auto tower = [up, lo](const int height) {
+		// up^(lo^height) = exp(lo^height * ln(up))
+		WideDouble exponent = wide_multiply(wide_pow(to_wide(lo), height),
+											to_wide(std::log(up)));
+		return std::exp(from_wide(exponent));
+	};
+	check_number_error(double_to_text(tower(count - 1)));
+	return tower(count);
+}
+
+// applies binary_op count times, checking every step
+// stops early at a fixed point, or at a cycle of two values
+double Calculator::repeat_steps(const char binary_op, const double up,
+								const double lo, const int count) {
+	double value = up;
+	double previous = NAN;
+	for (int i = 0; i < count; ++i) {
+		check_task(i, count);
+		check_binary_error(binary_op, value, lo);
+		double next = calculate_binary(binary_op, value, lo);
+		if (!std::isfinite(next))
+			check_number_error(double_to_text(next));
+		if (next == value)
+			return next;
+		if (next == previous)
+			return ((count - 1 - i) % 2 == 0) ? next : value;
+		previous = value;
+		value = next;
+	}
+	return value;
+}
+
+//-------------------------------tasks-------------------------------
+
+// runs work, which returns the new upper value or throws an error message
+// and updates the repeat as it goes, on task_thread if cost is over
+// TASK_COST, then finish_task() shows the result like equals would
+// work can't touch widgets, it may run on another thread
+void Calculator::run_task(const std::function<double(Repeat &)> &work, 
+						  const Repeat &repeat, const long long cost) {
+	task_repeat = repeat;
+	task_error.clear();
+	task_cancelled = false;
+	if (cost <= TASK_COST) {
+		try {
+			task_value = work(task_repeat);
+		}
+		catch (const QString &error_message) {
+			task_error = error_message;
+		}
+		finish_task();
+		return;
+	}
+	
+	task_running = true;
+	task_done = false;
+	task_progress = 0;
+	task_display = upper_display->view();
+	upper_display->setText(u"busy");
+	setCursor(Qt::BusyCursor);
+	task_thread = std::thread([this, work] {
+		try {
+			task_value = work(task_repeat);
+		}
+		catch (const QString &error_message) {
+			task_error = error_message;
+		}
+		catch (const TaskCancelled &) {
+			// the result is never read
+		}
+		task_done.store(true, std::memory_order_release);
+	});
+	task_timer->start();
+}
+
+// clears the displays to the task's result and adds an event frame
+void Calculator::finish_task() {
+	DisplayText new_value;
+	try {
+		if (!task_error.isEmpty())
+			throw task_error;
+		new_value = double_to_text(task_value);
+		check_number_error(new_value);
+	}
+	catch (const QString &error_message) {
+		active_has_error = true;
+		new_value = error_message;
+	}
+	print_state();
+	clear_displays(new_value);
+	push_frame(new_value, task_repeat);
+}
+
+// stops the running task and drops the events queued during it
+// the task stops at its next check, poll_task() then cleans up
+void Calculator::cancel_task() {
+	task_cancelled = true;
+	queued_events.clear();
+	upper_display->setText(task_display);
+}
+
+// called by task_timer, shows progress and finishes the task once done
+// then replays the queued events in order, which may start another task
+void Calculator::poll_task() {
+	if (!task_done.load(std::memory_order_acquire)) {
+		if (!task_cancelled) {
+			upper_display->setText(QString("busy %1%")
+								   .arg(task_progress / 10));
+		}
+		return;
+	}
+	task_thread.join();
+	task_timer->stop();
+	task_running = false;
+	upper_display->setText(task_display);
+	if (!task_cancelled)
+		finish_task();
+	publish_state('\0');
+	// a task started by a replayed event, the replay goes on and replays
+	// the queued events once it is done
+	if (replay_running()) {
+		replay_timer->start();
+		return;
+	}
+	unsetCursor();
+	
+	QVector<QueuedEvent> events;
+	events.swap(queued_events);
+	for (const QueuedEvent &queued : events)
+		do_event(queued.event, queued.add_this_event);
+}
+
+// called by work, throws TaskCancelled if the task was cancelled,
+// otherwise records that done of total steps are done
+void Calculator::check_task(const long long done, const long long total) {
+	if (task_cancelled.load(std::memory_order_relaxed))
+		throw TaskCancelled();
+	task_progress.store(done * 1000 / total, std::memory_order_relaxed);
+}
+
+// replays events count times through do_event(), in chunks if there are
+// more than REPLAY_CHUNK
+// the first chunk runs now, so short replays finish before this returns
+void Calculator::start_replay(const QString &events, const int count) {
+	if (events.isEmpty())
+		return;
+	replay_events = events;
+	replay_next = 0;
+	replay_total = (long long)count * events.size();
+	if (replay_total > REPLAY_CHUNK) {
+		setCursor(Qt::BusyCursor);
+		replay_timer->start();
+	}
+	replay_step();
+}
+
+// replays the next chunk of a macro, then replays the events queued
+// meanwhile once done
+// while an event it replayed runs as a task the replay pauses, and
+// poll_task() resumes it
+// every replayed event is its own undoable frame, as if it was typed
+void Calculator::replay_step() {
+	const int size = replay_events.size();
+	for (int i = 0; i < REPLAY_CHUNK && replay_next < replay_total; ++i) {
+		if (task_running) {
+			replay_timer->stop();
+			return;
+		}
+		replaying_event = true;
+		do_event(replay_events[int(replay_next % size)].toLatin1(), true);
+		replaying_event = false;
+		++replay_next;
+	}
+	if (replay_running())
+		return;
+	replay_timer->stop();
+	replay_events.clear();
+	// the last event may have started a task, which replays the queue
+	if (task_running)
+		return;
+	unsetCursor();
+	QVector<QueuedEvent> events;
+	events.swap(queued_events);
+	for (const QueuedEvent &queued : events)
+		do_event(queued.event, queued.add_this_event);
+}
+
+// stops the replay and drops the events queued during it
+// the events already replayed stay, and can be undone
+void Calculator::cancel_replay() {
+	replay_timer->stop();
+	replay_events.clear();
+	replay_next = replay_total = 0;
+	queued_events.clear();
+	if (!task_running)
+		unsetCursor();
+}
+
+bool Calculator::replay_running() const {
+	return replay_next < replay_total;
+}
+
+//-----------------------------rpn mode------------------------------
+
+// switches between RPN mode and the two display mode
+// entering pushes the active value, leaving moves the top of the stack
+// to the upper display as a new event frame
+// macros can't be recorded in RPN mode, so it can't be switched while recording
+void Calculator::on_rpn_mode() {
+	if (recording_macro)
+		throw BadStateError();
+	if (!rpn_mode) {
+		// a full stack just doesn't take the value
+		QStringView active_str = active_display->view();
+		if (!active_has_error && active_str != u"0")
+			rpn_stack.push(string_to_double(active_str));
+		rpn_mode = true;
+		rpn_typing = false;
+		if (rpn_depth_strings.isEmpty()) {
+			for (int i = 0; i <= RpnStack::CAPACITY; ++i)
+				rpn_depth_strings.append(QString("[%1]").arg(i));
+		}
+		update_rpn_displays();
+		return;
+	}
+	rpn_push_entry();
+	DisplayText value = u"0";
+	if (rpn_stack.size() > 0) {
+		value = double_to_text(rpn_stack.at(0));
+		rpn_stack.drop();
+	}
+	rpn_mode = false;
+	active_has_error = false;
+	cur_binary_op = '\0';
+	clear_displays(value);
+	push_frame(value);
+}
+
+// applies a digit, point, e or s to str, returns false if it isn't allowed
+static bool edit_number(DisplayText &str, bool &overwrite, const char event) {
+	switch (event) {
+		case 'e':
+			return edit_scientific(str, overwrite);
+		case 's':
+			return edit_sign(str);
+	}
+	return edit_digit(str, overwrite, event);
+}
+
+// handles event in RPN mode, do_event() calls this for all but 'o' and
+// the panels 'h' and '#'
+// an error leaves the stack as it was and shows in the lower display until
+// the next event, returns whether the event was recognized
+bool Calculator::do_rpn_event(const char event) {
+	QString error;
+	try {
+		switch (event) {
+			case '0' ... '9':
+			case '.':
+			case 'e':
+			case 's':
+				rpn_edit(event);
+				break;
+			case '+':
+			case '-':
+			case 'x':
+			case 'd':
+			case '^':
+			case 'l':
+			case 'm':
+				rpn_binary(event);
+				break;
+			case 'r':
+			case 'i':
+			case '!':
+				rpn_unary(event);
+				break;
+			case 'q':
+				rpn_enter();
+				break;
+			case 'j':
+				rpn_drop();
+				break;
+			case 'y':
+				rpn_push_entry();
+				if (!rpn_stack.swap())
+					throw BadStateError();
+				break;
+			case 'b':
+				rpn_push_entry();
+				if (!rpn_stack.roll())
+					throw BadStateError();
+				break;
+			case 'c':
+				rpn_clear();
+				break;
+			case 'u':
+				rpn_undo();
+				break;
+			case 'a':
+				rpn_stat_add();
+				break;
+			case 'v':
+				rpn_recall();
+				break;
+			default:
+				return false;
+		}
+	}
+	catch (const BadStateError &error) {
+		// the event is ignored, though the entry may have been pushed
+	}
+	catch (const QString &error_message) {
+		error = error_message;
+	}
+	update_rpn_displays();
+	if (!error.isEmpty())
+		lower_display->setText(error);
+	return true;
+}
+
+// applies a digit, point, e or s to the entry, starting one if needed
+// s without an entry negates the top of the stack instead
+void Calculator::rpn_edit(const char event) {
+	if (!rpn_typing && event == 's') {
+		// like edit_sign(), 0 has no sign to swap
+		if (rpn_stack.size() == 0 || rpn_stack.at(0) == 0)
+			throw BadStateError();
+		rpn_stack.replace(1, -rpn_stack.at(0));
+		return;
+	}
+	DisplayText entry = rpn_typing ? rpn_entry : DisplayText();
+	bool overwrite = rpn_typing ? rpn_entry_overwrite : true;
+	// the entry can't hold more edits than undo can replay
+	if (rpn_typing && rpn_entry_events.size() == DisplayText::MAX_LENGTH)
+		throw BadStateError();
+	if (!edit_number(entry, overwrite, event))
+		throw BadStateError();
+	if (!rpn_typing)
+		rpn_entry_events.clear();
+	rpn_entry_events.append(event);
+	rpn_entry = entry;
+	rpn_entry_overwrite = overwrite;
+	rpn_typing = true;
+}
+
+// pushes the entry if a number is being typed
+// the entry is rounded like a display, so it stays as typed
+void Calculator::rpn_push_entry() {
+	if (!rpn_typing)
+		return;
+	if (!rpn_stack.push(round_to_display(string_to_double(rpn_entry))))
+		throw BadStateError();
+	rpn_typing = false;
+}
+
+// pushes the entry, or duplicates the top of the stack if there isn't one
+void Calculator::rpn_enter() {
+	if (rpn_typing) {
+		rpn_push_entry();
+		return;
+	}
+	if (rpn_stack.size() == 0 || !rpn_stack.push(rpn_stack.at(0)))
+		throw BadStateError();
+}
+
+// replaces the top two entries with the second op the top
+// calculated and checked like equals, can throw an error message
+void Calculator::rpn_binary(const char binary_op) {
+	rpn_push_entry();
+	if (rpn_stack.size() < 2)
+		throw BadStateError();
+	const double up = rpn_stack.at(1);
+	const double lo = rpn_stack.at(0);
+	rpn_stack.replace(2, binary_step(binary_op, up, lo));
+}
+
+// replaces the top entry with unary_op applied to it
+// can throw an error message
+void Calculator::rpn_unary(const char unary_op) {
+	rpn_push_entry();
+	if (rpn_stack.size() == 0)
+		throw BadStateError();
+	const double value = rpn_stack.at(0);
+	check_unary_error(unary_op, value);
+	rpn_stack.replace(1, round_to_display(calculate_unary(unary_op, value)));
+}
+
+// discards the entry, or removes the top of the stack
+void Calculator::rpn_drop() {
+	if (rpn_typing)
+		rpn_typing = false;
+	else if (!rpn_stack.drop())
+		throw BadStateError();
+}
+
+// discards the entry, or empties the stack
+// a discarded entry can't be undone, an emptied stack can
+void Calculator::rpn_clear() {
+	if (rpn_typing)
+		rpn_typing = false;
+	else if (!rpn_stack.clear())
+		throw BadStateError();
+}
+
+// undoes the last edit of the entry, or the last change to the stack
+// the entry is rebuilt from its edits, at most DisplayText::MAX_LENGTH of
+// them, the stack undoes its own deltas, so undo never replays the session
+void Calculator::rpn_undo() {
+	if (!rpn_typing) {
+		if (!rpn_stack.undo())
+			throw BadStateError();
+		return;
+	}
+	rpn_entry_events.remove(rpn_entry_events.size() - 1);
+	rpn_typing = !rpn_entry_events.is_empty();
+	rpn_entry.clear();
+	rpn_entry_overwrite = true;
+	for (int i = 0; i < rpn_entry_events.size(); ++i)
+		edit_number(rpn_entry, rpn_entry_overwrite, rpn_entry_events[i]);
+}
+
+// adds the entry or the top of the stack to the statistics data set
+void Calculator::rpn_stat_add() {
+	if (rpn_typing)
+		stats_panel->add_value(string_to_double(rpn_entry));
+	else if (rpn_stack.size() > 0)
+		stats_panel->add_value(rpn_stack.at(0));
+	else
+		throw BadStateError();
+	stats_panel->show();
+}
+
+// pushes recalled_value
+void Calculator::rpn_recall() {
+	QString value;
+	value.swap(recalled_value);
+	if (value.isEmpty() || value.contains("error"))
+		throw BadStateError();
+	rpn_push_entry();
+	if (!rpn_stack.push(string_to_double(value)))
+		throw BadStateError();
+}
+
+// shows the top of the stack and the entry in the displays
+void Calculator::update_rpn_displays() {
+	const int size = rpn_stack.size();
+	// while typing the entry takes the lower display and the stack moves up
+	const int upper_level = rpn_typing ? 0 : 1;
+	upper_display->setText((size > upper_level) 
+						   ? double_to_text(rpn_stack.at(upper_level)) 
+						   : DisplayText());
+	if (rpn_typing)
+		lower_display->setText(rpn_entry);
+	else
+		lower_display->setText((size > 0) ? double_to_text(rpn_stack.at(0)) 
+										  : DisplayText());
+	binary_display->setText(rpn_depth_strings[size]);
 }
 
 //-------------------------display functions-------------------------
 
 // clears displays and sets active display to upper
 // triggers overwrite flag, but does not alter active_has_error
-void Calculator::clear_displays(const QString &reset_val) {
+void Calculator::clear_displays(QStringView reset_val) {
 	overwrite_on_input = true;
 	active_display = upper_display;
 	upper_display->setText(reset_val);
-	lower_display->setText("");
-	binary_display->setText("");
+	lower_display->setText(u"");
+	binary_display->clear();
 }
 
 // updates the memory display based on stored memory strings
 void Calculator::update_memory_display() {
-	if (memory1.isEmpty())
+	if (memory1.is_empty())
 		mem1_state->setChecked(false);
 	else
 		mem1_state->setChecked(true);
-	if (memory2.isEmpty())
+	if (memory2.is_empty())
 		mem2_state->setChecked(false);
 	else
 		mem2_state->setChecked(true);
@@ -453,172 +1390,222 @@ void Calculator::update_memory_display() {
 
 // these handle string conversion
 QString Calculator::double_to_string(const double value) {
-	return QString().setNum(value, 'g', MAX_PRECISION);
+	return double_to_text(value).to_string();
 }
 
-double Calculator::string_to_double(const QString &str) {
-	bool ok = true;
-	double value = str.toDouble(&ok);
-	if (ok)
-		return value;
-	else if (str.endsWith("e+") || str.endsWith("e-"))
-		return string_to_double(str.chopped(2));
-	else
-		return value;
+// formats like QString::setNum(value, 'g', MAX_PRECISION) into a stack buffer
+DisplayText Calculator::double_to_text(const double value) {
+	return format_number(value);
 }
 
-// checks if str is at the max precision
-bool Calculator::at_max_precision(QString str) {
-	int exp_pos = str.indexOf('e');
-	if (exp_pos != -1) {
-		// compare the length of the numbers starting after e
-		return (str.length() - (exp_pos + 2)) >= EXP_PRECISION;
-	} else {
-		// remove non significant features, then compare the length
-		str.remove('-');
-		if (str.startsWith('0'))
-			str.remove(0,1);
-		str.remove('.');
-		return str.length() >= MAX_PRECISION;
-	}
+// reads the longest number at the start of str, so "1e+" reads as 1
+// returns 0 if str doesn't start with a number
+double Calculator::string_to_double(QStringView str) {
+	return parse_number(DisplayText(str));
 }
 
-// returns the result of cur_binary_op applied to up and lo
-double Calculator::calculate_binary(const double up, const double lo) {
-	switch (cur_binary_op) {
-		case '+':
-			return up + lo;
-		case '-':
-			return up - lo;
-		case 'x':
-			return up * lo;
-		case 'd':
-			return up / lo;
-		case '^':
-			return std::pow(up, lo);
-		case 'l': // log base up of lo
-			return std::log(lo) / std::log(up);
-		case 'm':
-			return std::fmod(up, lo);
+// returns the value a display would hold after showing value
+// the same as string_to_double(double_to_text(value)), but usually without
+// formatting: when value scaled to MAX_PRECISION digits has an exact power
+// of ten and isn't close to a rounding tie, rounding the scaled value and
+// dividing by the power of ten gives the same correctly rounded result
+// throws the check_number_error() messages for inf and nan
+double Calculator::round_to_display(const double value) {
+	if (!std::isfinite(value))
+		check_number_error(double_to_text(value));
+	if (value == 0)
+		return value;
+	
+	// estimate the decimal exponent from the binary one, it may be one low
+	int binary_exp;
+	std::frexp(value, &binary_exp);
+	int shift = MAX_PRECISION - 1 - std::floor((binary_exp - 1) * LOG10_2);
+	auto scale = [&value](const int power) {
+		return (power >= 0) ? value * EXACT_POW10[power] 
+							: value / EXACT_POW10[-power];
+	};
+	if (shift > -22 && shift <= 22) {
+		double scaled = scale(shift);
+		if (std::fabs(scaled) >= EXACT_POW10[MAX_PRECISION])
+			scaled = scale(--shift);
+		double digits = std::round(scaled);
+		// the scaled value is off by at most about 1e-6
+		double tie_distance = std::fabs(std::fabs(scaled - std::trunc(scaled))
+										- 0.5);
+		if (std::fabs(digits) < EXACT_POW10[MAX_PRECISION] && 
+			tie_distance > 1e-5) {
+			return (shift >= 0) ? digits / EXACT_POW10[shift]
+								: digits * EXACT_POW10[-shift];
+		}
 	}
-	return -420;
+	return string_to_double(double_to_text(value));
 }
 
-// because cmath doesn't have a factorial function
-// only defined to 20!
-long long factorial(int n) {
-	if (n < 0 || n >= 21)
-		return -1;
-	long long fact = 1;
-	for (int i=1; i <= n; ++i)
-		fact *= i;
-	return fact;
+// sets result to binary_op applied to up and lo as a display shows it,
+// or to the error message, the text is only set if with_text is
+// recurring ^ and l results come from result_cache, which keeps the text
+// too, so a miss formats it even if it isn't needed now
+void Calculator::binary_result(const char binary_op, const double up, 
+							   const double lo, const bool with_text, 
+							   CachedResult &result) {
+	ResultCache::Lookup lookup = ResultCache::BYPASSED;
+	if (ResultCache::caches(binary_op)) {
+		lookup = result_cache.lookup(binary_op, up, lo, result);
+		if (lookup == ResultCache::HIT)
+			return;
+	}
+	result.error = binary_error(binary_op, up, lo);
+	if (!result.error) {
+		result.value = calculate_displayed(binary_op, up, lo, 
+										   &precision_counters);
+		if (with_text || lookup == ResultCache::MISS 
+			|| !std::isfinite(result.value)) {
+			result.text = double_to_text(result.value);
+			result.error = number_error(result.text);
+			result.value = parse_number(result.text);
+		} else {
+			result.value = round_to_display(result.value);
+		}
+	}
+	if (result.error)
+		result.text = DisplayText::from_latin1(result.error);
+	if (lookup == ResultCache::MISS)
+		result_cache.insert(binary_op, up, lo, result);
 }
 
-// returns the result of unary_op applied to value
-double Calculator::calculate_unary(const char unary_op, const double value) {
-	switch (unary_op) {
-		case 'r':
-			return std::sqrt(value);
-		case '!':
-			return factorial(value);
-		case 'i':
-			return 1.0 / value;
-	}
-	return -69;
+// returns the value of binary_result(), throws the error message like
+// the error checkers
+double Calculator::binary_step(const char binary_op, const double up, 
+							   const double lo) {
+	CachedResult result;
+	binary_result(binary_op, up, lo, false, result);
+	if (result.error)
+		throw QString(result.error);
+	return result.value;
 }
 
 //--------------------------error checkers---------------------------
 // these all throw a QString containing the error message if an error is found
 // all error messages contain the string "error" in them
-// these functions are solely called by on_equals() and on_unary()
-// which wrap them in try catch blocks to handle the error messages
+// these functions are solely called by on_equals(), on_unary(), macros
+// and repeats, which wrap them in try catch blocks to handle the messages
 
 // checks for errors regarding invalid inputs to the binary operator
-void Calculator::check_binary_error(const double up, const double lo) {
-	switch (cur_binary_op) {
-		case '^':
-			if (up == 0 && lo == 0)
-				throw QString("0^0 error");
-			else if (up < 0 && std::fmod(lo, 1) != 0)
-				throw QString("neg root error");
-			break;
-		case 'd':
-			if (lo == 0)
-				throw QString("divide by 0 error");
-			break;
-		case 'l':
-			if (up == 0 || lo == 0)
-				throw QString("log 0 error");
-			else if (up < 0 || lo < 0)
-				throw QString("neg log error");
-			break;
-		case 'm':
-			if (lo == 0)
-				throw QString("mod 0 error");
-			break;
-	}
+void Calculator::check_binary_error(const char binary_op, const double up, 
+									const double lo) {
+	if (const char *error = binary_error(binary_op, up, lo))
+		throw QString(error);
 }
 
 // checks for errors regarding invalid inputs to the unary operator
 void Calculator::check_unary_error(const char unary_op, const double value) {
-	switch (unary_op) {
-		case 'r':
-			if (value < 0)
-				throw QString("neg root error");
-			break;
-		case '!':
-			if (value < 0)
-				throw QString("neg factorial error");
-			else if (value >= 21)
-				throw QString("factorial size error");
-			else if (std::fmod(value, 1) != 0)
-				throw QString("dec factorial error");
-			break;
-		case 'i':
-			if (value == 0)
-				throw QString("inverse 0 error");
-			break;
-	}
+	if (const char *error = unary_error(unary_op, value))
+		throw QString(error);
 }
 
 // checks for value equaling inf, -inf, or nan
-void Calculator::check_number_error(const QString &value) {
-	if (value == "inf")
-		throw QString("max size error");
-	else if (value == "-inf")
-		throw QString("min size error");
-	else if (value == "nan")
-		throw QString("nan error");
+void Calculator::check_number_error(QStringView value) {
+	if (const char *error = number_error(DisplayText(value)))
+		throw QString(error);
 }
 
 //---------------------------undo functions--------------------------
 
+// the event classes undo tells apart, binary ops set the lower display
+static bool is_binary_event(const char event) {
+	switch (event) {
+		case '+':
+		case '-':
+		case 'x':
+		case 'd':
+		case '^':
+		case 'l':
+		case 'm':
+			return true;
+	}
+	return false;
+}
+
+// recalls are undone like unary ops, from the display value they left
+static bool is_unary_event(const char event) {
+	return event == 'r' || event == 'i' || event == '!' || event == 'v';
+}
+
+static bool is_mem_event(const char event) {
+	return event == 'M' || event == 'W';
+}
+
+// returns how many events is_class is true for
+static int count_events(std::string_view events, bool (*is_class)(const char)) {
+	int count = 0;
+	for (char event : events) {
+		if (is_class(event))
+			++count;
+	}
+	return count;
+}
+
 // appends the given event to the event list for the current frame
 // also updates old mem values and old unary values
 void Calculator::add_event(const char event) {
 	switch (event) {
 		case 'M':
-			old_mem1_values.append(memory1);
-			all_mem_values.append(&old_mem1_values.last());
+			old_mem1_values.push_back(memory1);
+			all_mem_values.push_back(memory1);
 			break;
 		case 'W':
-			old_mem2_values.append(memory2);
-			all_mem_values.append(&old_mem2_values.last());
+			old_mem2_values.push_back(memory2);
+			all_mem_values.push_back(memory2);
 			break;
 		case 'r':
 		case 'i':
 		case '!':
-			old_unary_values.append(active_display->text());
+		case 'v':
+			old_unary_values.push_back(active_display->view());
 			break;
 		case 'q':
+			push_frame(upper_display->view(), equals_repeat);
+			return;
 		case 'c':
-			event_frames.append({ upper_display->text(), "" });
+			push_frame(upper_display->view());
 			// intentional fallthrough
 		case 'u':
 			return; // don't add functional inputs
+		case 'a':
+		case 'g':
+		case 'h':
+		case '#':
+			return; // panels don't change the calculator state
+		case 'k':
+		case 'p':
+		case 't':
+		case 'o':
+			return; // macros, repeats and RPN mode add their own frames
 	}
-	event_frames.last().second += event;
+	frame_events.push_back(event);
+	history_panel->frames_changed(get_frame_count() - 1);
+}
+
+// returns the frame events are currently added to
+Calculator::EventFrame &Calculator::current_frame() {
+	return event_frames.back();
+}
+
+// returns the events of the current frame
+std::string_view Calculator::current_events() {
+	return std::string_view(frame_events).substr(current_frame().events_begin);
+}
+
+// starts a new frame with the given value
+// frames and their events are reserved in the arena up front, so a new
+// frame usually doesn't allocate
+void Calculator::push_frame(QStringView value, const Repeat &repeat) {
+	EventFrame frame;
+	frame.value = value;
+	frame.events_begin = int(frame_events.size());
+	frame.repeat = repeat;
+	event_frames.push_back(frame);
+	history_panel->frames_changed(get_frame_count() - 1);
 }
 
 // updates the old value variables based on the last event
@@ -635,6 +1622,7 @@ void Calculator::remove_old_values(const char last_event) {
 		case 'r':
 		case 'i':
 		case '!':
+		case 'v':
 			old_unary_values.pop_back();
 			break;
 	}
@@ -642,77 +1630,124 @@ void Calculator::remove_old_values(const char last_event) {
 
 // sets the state of the calculator to that of the last event frame
 // updates the displays, flags, and memory to reflect the new state
+// replaying events doesn't add any, so recent_events stays valid
 void Calculator::reset_state() {
-	clear_displays(event_frames.last().first);
-	QString &recent_events = event_frames.last().second;
-	int unary_size = old_unary_values.size();
-	int mem_size = all_mem_values.size();
+	clear_displays(current_frame().value);
+	std::string_view recent_events = current_events();
+	int unary_size = int(old_unary_values.size());
+	int mem_size = int(all_mem_values.size());
 	
-	int first_binary_pos = recent_events.indexOf(VALID_BINARY);
-	QString upper_events = recent_events.left(first_binary_pos);
+	size_t first_binary_pos = 0;
+	while (first_binary_pos < recent_events.size() 
+		   && !is_binary_event(recent_events[first_binary_pos]))
+		++first_binary_pos;
+	std::string_view upper_events = recent_events.substr(0, first_binary_pos);
 	// only set the lower and binary displays if there was a binary operator
-	if (first_binary_pos == -1) {
+	if (first_binary_pos == recent_events.size()) {
 		reset_active_display(upper_events, unary_size, mem_size);
 	} else {
 		// set the upper, binary, then lower displays
-		QString lower_events = recent_events.mid(first_binary_pos);
+		std::string_view lower_events = recent_events.substr(first_binary_pos);
 		
-		int unary_offset = unary_size - lower_events.count(VALID_UNARY);
-		int mem_offset = mem_size - lower_events.count(VALID_MEM);
+		int unary_offset = unary_size - count_events(lower_events, is_unary_event);
+		int mem_offset = mem_size - count_events(lower_events, is_mem_event);
 		reset_active_display(upper_events, unary_offset, mem_offset);
 		
-		int last_binary_pos = recent_events.lastIndexOf(VALID_BINARY);
-		on_binary(recent_events[last_binary_pos].toLatin1());
+		size_t last_binary_pos = recent_events.size() - 1;
+		while (!is_binary_event(recent_events[last_binary_pos]))
+			--last_binary_pos;
+		on_binary(recent_events[last_binary_pos]);
 		// note the active display is now lower
 		reset_active_display(lower_events, unary_size, mem_size);
 	}
 	// update memory values
-	if (old_mem1_values.isEmpty())
+	if (old_mem1_values.empty())
 		memory1.clear();
 	else
-		memory1 = old_mem1_values.last();
-	if (old_mem2_values.isEmpty())
+		memory1 = old_mem1_values.back();
+	if (old_mem2_values.empty())
 		memory2.clear();
 	else
-		memory2 = old_mem2_values.last();
+		memory2 = old_mem2_values.back();
 	update_memory_display();
 }
 
 // requires active_display has been set to the default value
 // takes display_events, finds the most recent event that triggered overwrite,
 // updates the display to that point, then redoes all events after that point
-void Calculator::reset_active_display(QString &display_events, 
+// binary events are skipped, reset_state() sets the binary op
+void Calculator::reset_active_display(std::string_view display_events, 
 									  const int unary_offset, 
 									  const int mem_offset) {
-	display_events.remove(VALID_BINARY);
-	int last_unary_pos = display_events.lastIndexOf(VALID_UNARY);
-	int index = 0;
+	size_t index = 0;
+	size_t last_unary_pos = display_events.size();
+	for (size_t i = 0; i < display_events.size(); ++i) {
+		if (is_unary_event(display_events[i]))
+			last_unary_pos = i;
+	}
 	// find the last overwrite event, default is already accounted for
-	if (last_unary_pos != -1) {
+	if (last_unary_pos != display_events.size()) {
 		index = last_unary_pos + 1;
 		active_display->setText(old_unary_values.at(unary_offset - 1));
-	} else if (display_events[0] == 'M' || display_events[0] == 'W') {
-		index = 1;
-		int mem_pos = mem_offset - display_events.count(VALID_MEM);
-		active_display->setText(*all_mem_values.at(mem_pos));
+	} else {
+		while (index < display_events.size() 
+			   && is_binary_event(display_events[index]))
+			++index;
+		if (index < display_events.size() 
+			&& is_mem_event(display_events[index])) {
+			int mem_pos = mem_offset - count_events(display_events, is_mem_event);
+			active_display->setText(all_mem_values.at(mem_pos));
+			++index;
+		}
 	}
 	active_has_error = active_display->text().contains("error");
 	// redo the events starting from index
-	for (int i = index; i < display_events.size(); ++i) {
-		do_event(display_events[i].toLatin1(), false);
+	for (; index < display_events.size(); ++index) {
+		if (!is_binary_event(display_events[index]))
+			do_event(display_events[index], false);
 	}
 }
 
+//---------------------------state export----------------------------
+
+// copies up to CALC_SHM_TEXT_LENGTH characters of str into text
+static void copy_text(QStringView str, CalcShmText &text) {
+	const int length = std::min(int(str.size()), CALC_SHM_TEXT_LENGTH);
+	for (int i = 0; i < length; ++i)
+		text.chars[i] = str[i].unicode();
+	text.length = length;
+}
+
+// publishes the displays, memories, and flags for other processes
+// event is added to the published events unless it is '\0'
+// called after every event do_event() handles and after tasks finish
+void Calculator::publish_state(const char event) {
+	if (!state_export.is_open())
+		return;
+	CalcShmState state = {};
+	copy_text(upper_display->view(), state.upper);
+	copy_text(lower_display->view(), state.lower);
+	copy_text(memory1, state.memory1);
+	copy_text(memory2, state.memory2);
+	state.binary_op = cur_binary_op;
+	state.has_error = active_has_error;
+	state.rpn_mode = rpn_mode;
+	state.task_running = task_running || replay_running();
+	state_export.publish(state, event);
+}
+
 //----------------------------debuggers------------------------------
 
 // prints recent events, current displays, flags, and mem values
 // called in on_clear() and on_equals()
 void Calculator::print_state() {
+#ifdef CALC_DEBUG
 	out.setRealNumberPrecision(MAX_PRECISION);
-	if (!event_frames.isEmpty()) {
+	if (!event_frames.empty()) {
+		std::string_view events = current_events();
 		out << "\n---info---"
-		<< "\nenter val:\t" << event_frames.last().first
-		<< "\nevents:\t" << event_frames.last().second;
+		<< "\nenter val:\t" << current_frame().value.to_string()
+		<< "\nevents:\t" << QLatin1String(events.data(), int(events.size()));
 		out << "\n--displays--"
 		<< "\nupper:\t" << upper_display->text()
 		<< "\nbinary:\t" << binary_display->text()
@@ -721,32 +1756,45 @@ void Calculator::print_state() {
 		<< "\noverwrite:\t" << overwrite_on_input
 		<< "\nhas_error:\t" << active_has_error;
 		out << "\n--memory--"
-		<< "\n1:\t" << memory1
-		<< "\n2:\t" << memory2;
+		<< "\n1:\t" << memory1.to_string()
+		<< "\n2:\t" << memory2.to_string();
+		out << "\n--precision--"
+		<< "\nevaluated:\t" << precision_counters.evaluated
+		<< "\nescalated:\t" << precision_counters.escalated;
+		CacheCounters cache = result_cache.counters();
+		out << "\n--result cache--"
+		<< "\nhits:\t" << cache.hits
+		<< "\nmisses:\t" << cache.misses
+		<< "\nbypassed:\t" << cache.bypassed;
 		out << '\n';
+		out.flush();
 	}
+#endif
 }
 
 // prints past event frames and the values of old mem and old unary
 // called in the destructor
 void Calculator::print_all_events() {
+#ifdef CALC_DEBUG
 	out << "\nevent list:";
-	foreach(auto pair, event_frames) {
-		out << "\n  val:    " << pair.first;
-		out << "\n  events: " << pair.second;
+	for (int i = 0; i < int(event_frames.size()); ++i) {
+		std::string_view events = get_frame_events(i);
+		out << "\n  val:    " << event_frames[i].value.to_string();
+		out << "\n  events: " << QLatin1String(events.data(), int(events.size()));
 	}
 	out << "\n\nunary values:\n  ";
-	foreach(QString str, old_unary_values) {
-		out << str << ", ";
+	for (const DisplayText &str : old_unary_values) {
+		out << str.to_string() << ", ";
 	}
 	out << "\nmem1 values:\n  ";
-	foreach(QString str, old_mem1_values) {
-		out << str << ", ";
+	for (const DisplayText &str : old_mem1_values) {
+		out << str.to_string() << ", ";
 	}
 	out << "\nmem2 values:\n  ";
-	foreach(QString str, old_mem2_values) {
-		out << str << ", ";
+	for (const DisplayText &str : old_mem2_values) {
+		out << str.to_string() << ", ";
 	}
 	out << '\n';
+	out.flush();
+#endif
 }
-
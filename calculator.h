@@ -1,13 +1,33 @@
 #pragma once
 
 #include "calclabel.h"
+#include "calcdisplay.h"
+#include "statspanel.h"
+#include "graphpanel.h"
+#include "historypanel.h"
+#include "matrixpanel.h"
+#include "calcengine.h"
+#include "rpnstack.h"
+#include "resultcache.h"
+#include "stateexport.h"
 #include <QWidget>
-#include <QRegularExpression>
 #include <QRadioButton>
 #include <QStringList>
 #include <QKeyEvent>
+#include <QTimer>
 #include <QList>
-#include <QPair>
+#include <QVector>
+#include <QMap>
+#include <atomic>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef CALC_DEBUG
+#include <QTextStream>
+#endif
 
 class Calculator : public QWidget {
 	Q_OBJECT
@@ -15,9 +35,11 @@ class Calculator : public QWidget {
 public:
 	// constructor
 	// initializes variables and displays, adds buttons, sets the layout
-	Calculator(QWidget *parent = 0);
+	// session numbers the calculators open at once, each publishes its state
+	// to its own shared memory segment
+	Calculator(const int session = 0, QWidget *parent = 0);
 	// destructor
-	// calls print_all_events()
+	// stops a running task, calls print_all_events()
 	~Calculator();
 	
 	// public getters for viewing state
@@ -26,22 +48,50 @@ public:
 	QString get_memory1();
 	QString get_memory2();
 	char get_binary_op();
+	// how often ^ and l results were found in the result cache
+	CacheCounters get_cache_counters();
+	// the event frames, for the history panel
+	int get_frame_count();
+	QString get_frame_value(const int index);
+	std::string_view get_frame_events(const int index);
+	
+	// puts value in the active display as an undoable event, like a memory
+	void recall_value(const QString &value);
 	
 	// calls an input function based on event, also calls add_event()
 	// returns whether the event was recognized by the switch statement
+	// while a task or a replay runs, 'c' cancels it and other events are
+	// queued
 	bool do_event(const char event, bool add_this_event);
 	
+	// number formatting and error checks shared with the statistics panel
+	QString double_to_string(const double val);
+	double string_to_double(QStringView str);
+	// checks for value equaling inf, -inf, or nan
+	void check_number_error(QStringView value);
+	
 protected:
 	// sends key presses to do_event(), passes on to QWidget if not recognized
 	void keyPressEvent(QKeyEvent *event);
 	
+private slots:
+	// called by task_timer, shows progress and finishes the task once done
+	void poll_task();
+	// called by replay_timer, replays the next chunk of a macro
+	void replay_step();
+	
 private:
 	//-------------------------------variables-------------------------------
+	// the undo history and the values it restores are carved from arena,
+	// which is freed in one shot when the session closes
+	// it only grows, containers that outgrow a block leave it unused
+	static constexpr size_t ARENA_SIZE = 1 << 16;
+	std::pmr::monotonic_buffer_resource arena{ARENA_SIZE};
 	// the number displays that both store and show information to the user
-	CalcLabel *upper_display;
-	CalcLabel *lower_display;
+	CalcDisplay *upper_display;
+	CalcDisplay *lower_display;
 	// points to upper or lower, whichever is active
-	CalcLabel *active_display;
+	CalcDisplay *active_display;
 	// shows the unicode version of cur_binary_op
 	CalcLabel *binary_display;
 	// the operator to be used by on_equals
@@ -50,8 +100,53 @@ private:
 	QRadioButton *mem1_state;
 	QRadioButton *mem2_state;
 	// the stored memory values
-	QString memory1;
-	QString memory2;
+	DisplayText memory1;
+	DisplayText memory2;
+	// accumulates values for the statistics mode, hidden until first used
+	StatsPanel *stats_panel;
+	// plots compiled macros, hidden until first used
+	GraphPanel *graph_panel;
+	// lists the event frames, hidden until first used
+	HistoryPanel *history_panel;
+	// holds the matrix registers, hidden until first used
+	MatrixPanel *matrix_panel;
+	// the value recall_value() passes to on_recall()
+	QString recalled_value;
+#ifdef CALC_DEBUG
+	// print_state() and print_all_events() write here
+	QTextStream out{stdout};
+#endif
+	// publishes the state to other processes after every event
+	StateExport state_export;
+	
+	//----------------------------macro variables----------------------------
+	// a recorded run of events, compiled into steps when possible
+	struct Macro {
+		QString events;
+		bool compiled = false;
+		QVector<CalcStep> steps;
+	};
+	QMap<QString, Macro> macros;
+	bool recording_macro = false;
+	QString recorded_events;
+	// appended to the window title while recording
+	const QString RECORDING_TITLE = " (recording)";
+	
+	//-----------------------------rpn variables-----------------------------
+	// in RPN mode the lower display shows the top of the stack and the upper
+	// display the entry below it, while a number is typed it takes the lower
+	// display and the stack moves up one
+	bool rpn_mode = false;
+	RpnStack rpn_stack;
+	// the number being typed, pushed by enter or by the next op
+	DisplayText rpn_entry;
+	bool rpn_typing = false;
+	bool rpn_entry_overwrite = true;
+	// the edits that built rpn_entry, undo replays all but the last
+	DisplayText rpn_entry_events;
+	// the binary display shows the stack depth, the strings are built when
+	// the session first enters RPN mode so updates never allocate
+	QVector<QString> rpn_depth_strings;
 	
 	// error flags: active_has error implies overwrite
 	// however overwrite doesn't imply active_has_error
@@ -59,29 +154,90 @@ private:
 	bool active_has_error = false;
 	
 	// precision constants
-	const int MAX_PRECISION = 10;
-	const int EXP_PRECISION = 3;
+	const int MAX_PRECISION = DISPLAY_PRECISION;
+	
+	// how often results near the precision limit were recalculated exactly
+	// only written by whichever of the UI thread and a task is calculating
+	PrecisionCounters precision_counters;
+	// results of ^ and l, which macros, repeats and RPN keep recalculating
+	ResultCache result_cache;
 	
 	// a unique class I can throw to simplify some logic
-	// the only function that catches it is do_event()
-	// and the only functions that throw it are exclusively called by do_event()
+	// the only functions that catch it are do_event() and compile_macro()
+	// and the only functions that throw it are exclusively called by those
 	class BadStateError{};
 	
 	//----------------------------undo variables-----------------------------
+	// a binary op and its lower value, repeated by equals without a lower value
+	struct Repeat {
+		char op = '\0';
+		double operand = 0;
+	};
 	// a frame is whenever the displays are cleared and a value is put in upper
-	// first is the value of upper at that frame
-	// second is the event list for that frame
-	QList<QPair<QString, QString>> event_frames = { {QString("0"), "" } };
+	struct EventFrame {
+		// the value of upper at that frame
+		DisplayText value;
+		// where the frame's events start in frame_events, they run to the
+		// start of the next frame
+		int events_begin = 0;
+		// the op equals repeats in this frame, set by the equals that made it
+		Repeat repeat;
+	};
+	std::pmr::vector<EventFrame> event_frames{&arena};
+	// the events of all frames, only the last frame's events change
+	std::pmr::string frame_events{&arena};
+	// how many frames, and events per frame, to reserve at first
+	const int FRAME_CHUNK = 64;
+	const int FRAME_EVENTS = 32;
+	// set by on_equals() for the frame it starts
+	Repeat equals_repeat;
+	
+	//-----------------------------task variables----------------------------
+	// long macro runs and repeats are tasks run on task_thread, so the window
+	// keeps responding, events that arrive meanwhile wait in queued_events
+	// a calculation costing more steps than this runs as a task
+	const long long TASK_COST = 1 << 16;
+	std::thread task_thread;
+	bool task_running = false;
+	// set to stop the task, which checks it between steps
+	std::atomic<bool> task_cancelled{false};
+	// set by the task once its result is written
+	std::atomic<bool> task_done{false};
+	// how far the task has got in thousandths, shown in the upper display
+	std::atomic<int> task_progress{0};
+	// the result of the task, only read once task_done is set
+	double task_value = 0;
+	QString task_error;
+	Repeat task_repeat;
+	// the upper value, put back when the task finishes or is cancelled
+	DisplayText task_display;
+	// polls the task about once a frame
+	QTimer *task_timer;
+	struct QueuedEvent {
+		char event;
+		bool add_this_event;
+	};
+	QVector<QueuedEvent> queued_events;
+	// thrown inside a task once task_cancelled is set
+	class TaskCancelled{};
+	// macros that can't be compiled replay their events on the UI thread,
+	// since events touch widgets, a chunk per replay_timer tick so the
+	// window keeps responding, events that arrive meanwhile are queued
+	const int REPLAY_CHUNK = 1024;
+	QString replay_events;
+	// the next event and the event count, counting through every repeat
+	long long replay_next = 0;
+	long long replay_total = 0;
+	// set while replay_step() runs an event, so it isn't queued
+	bool replaying_event = false;
+	QTimer *replay_timer;
 	// I refuse to recalculate old events when undoing
 	// these variables compensate for that limitation
-	QStringList old_unary_values;
-	QList<QString *> all_mem_values;
-	QStringList old_mem1_values;
-	QStringList old_mem2_values;
-	// determine binary, unary, and mem locations in undo
-	const QRegularExpression VALID_BINARY = QRegularExpression("[+\\-xd^lm]");
-	const QRegularExpression VALID_UNARY = QRegularExpression("[ri!]");
-	const QRegularExpression VALID_MEM = QRegularExpression("[MW]");
+	std::pmr::vector<DisplayText> old_unary_values{&arena};
+	// the values of both memories in the order they were stored
+	std::pmr::vector<DisplayText> all_mem_values{&arena};
+	std::pmr::vector<DisplayText> old_mem1_values{&arena};
+	std::pmr::vector<DisplayText> old_mem2_values{&arena};
 	
 	//----------------------------regular inputs-----------------------------
 	// adds a digit to the active display, also handles decimal points
@@ -104,9 +260,19 @@ private:
 	// swaps the sign of the number or if the number has e, the sign of e
 	// will still swap if overwrite is set
 	void on_sign();
-
+	// adds the active display value to the statistics data set
+	// doesn't change the calculator state, so it isn't recorded for undo
+	void on_stat_add();
+	// shows the history panel
+	void on_history();
+	// shows the matrix panel
+	void on_matrix();
+	// writes recalled_value to the active display, triggers overwrite
+	void on_recall();
+	
 	//---------------------------functional inputs---------------------------
-	// either recalculates the upper display, or does the binary calculation
+	// does the binary calculation, repeats the last one if lower isn't set,
+	// or recalculates the upper display if there is nothing to repeat
 	// clears the display and places the value in the upper display
 	// triggers overwrite, can trigger active_has_error
 	void on_equals();
@@ -115,40 +281,137 @@ private:
 	// returns the calculator to the previous state before the most recent event
 	void on_undo();
 	
+	//--------------------------------macros---------------------------------
+	// starts recording events, or stops and saves them as a named macro
+	void on_record();
+	// asks for a macro and a repeat count, then plays it
+	// compiled macros run on the upper value and add a single event frame,
+	// other macros replay their events through do_event(), in chunks
+	void on_play();
+	// appends a recorded event to recorded_events, undo removes the last one
+	void record_event(const char event);
+	// turns the events of macro into steps, returns false if it can't
+	bool compile_macro(Macro &macro);
+	// runs the compiled steps count times on the upper value
+	// only updates the displays once, stops at the first error
+	void run_compiled_macro(const Macro &macro, const int count);
+	// asks for a compiled macro and plots it as a function of the upper value
+	void on_graph();
+	
+	//--------------------------------repeats--------------------------------
+	// asks for a count, then applies the op equals would repeat that many times
+	// the result is exact rather than rounded for the display after every step
+	// clears the display like equals, adding a single event frame for undo
+	void on_repeat();
+	// returns binary_op applied count times, each time with lo and the last result
+	// uses a closed form where possible, throws the error message of the
+	// failing step like the error checkers
+	double repeat_binary(const char binary_op, const double up, 
+						 const double lo, const int count);
+	// returns ((up^lo)^lo)... count times for up > 0
+	double repeat_power(const double up, const double lo, const int count);
+	// applies binary_op count times, stopping early at a fixed point or cycle
+	double repeat_steps(const char binary_op, const double up, 
+						const double lo, const int count);
+	
+	//---------------------------------tasks---------------------------------
+	// runs work, which returns the new upper value or throws an error message
+	// and updates the repeat as it goes, on task_thread if cost is over
+	// TASK_COST, then finish_task() shows the result like equals would
+	// work can't touch widgets, it may run on another thread
+	void run_task(const std::function<double(Repeat &)> &work, 
+				  const Repeat &repeat, const long long cost);
+	// clears the displays to the task's result and adds an event frame
+	void finish_task();
+	// stops the running task and drops the events queued during it
+	void cancel_task();
+	// called by work, throws TaskCancelled if the task was cancelled,
+	// otherwise records that done of total steps are done
+	void check_task(const long long done, const long long total);
+	// replays events count times through do_event(), in chunks if there
+	// are more than REPLAY_CHUNK
+	void start_replay(const QString &events, const int count);
+	// stops the replay and drops the events queued during it
+	void cancel_replay();
+	bool replay_running() const;
+	
+	//-------------------------------rpn mode--------------------------------
+	// switches between RPN mode and the two display mode
+	// entering pushes the active value, leaving moves the top of the stack
+	// to the upper display as a new event frame
+	void on_rpn_mode();
+	// handles event in RPN mode, do_event() calls this for all but 'o' and
+	// the panels 'h' and '#'
+	// RPN events keep their own undo as stack deltas, not in event frames
+	// returns whether the event was recognized
+	bool do_rpn_event(const char event);
+	// applies a digit, point, e or s to the entry, starting one if needed
+	// s without an entry negates the top of the stack instead
+	void rpn_edit(const char event);
+	// pushes the entry if a number is being typed
+	void rpn_push_entry();
+	// pushes the entry, or duplicates the top of the stack if there isn't one
+	void rpn_enter();
+	// replaces the top two entries with the second op the top
+	void rpn_binary(const char binary_op);
+	// replaces the top entry with unary_op applied to it
+	void rpn_unary(const char unary_op);
+	// discards the entry, or removes the top of the stack
+	void rpn_drop();
+	// discards the entry, or empties the stack
+	void rpn_clear();
+	// undoes the last edit of the entry, or the last change to the stack
+	void rpn_undo();
+	// adds the entry or the top of the stack to the statistics data set
+	void rpn_stat_add();
+	// pushes recalled_value
+	void rpn_recall();
+	// shows the top of the stack and the entry in the displays
+	void update_rpn_displays();
+	
 	//--------------------------display functions----------------------------
 	// clears displays and sets active display to upper
 	// triggers overwrite flag, but does not alter active_has_error
-	void clear_displays(const QString &reset_val = "0");
+	void clear_displays(QStringView reset_val = u"0");
 	// updates the memory display based on stored memory strings
 	void update_memory_display();
 	
 	//---------------------------number functions----------------------------
-	// these handle string conversion
-	QString double_to_string(const double val);
-	double string_to_double(const QString &str);
-	// checks if str is at the max precision
-	bool at_max_precision(QString str);
-	// returns the result of cur_binary_op applied to up and lo
-	double calculate_binary(const double up, const double lo);
-	// returns the result of unary_op applied to value
-	double calculate_unary(const char unary_op, const double value);
+	// formats val into an inline buffer, the allocation free double_to_string
+	DisplayText double_to_text(const double val);
+	// returns the value a display would hold after showing value
+	double round_to_display(const double value);
+	// sets result to binary_op applied to up and lo as a display shows it,
+	// or to the error message, the text is only set if with_text is
+	// recurring ^ and l results come from result_cache
+	void binary_result(const char binary_op, const double up, const double lo,
+					   const bool with_text, CachedResult &result);
+	// returns the value of binary_result(), throws the error message like
+	// the error checkers
+	double binary_step(const char binary_op, const double up, const double lo);
 	
 	//----------------------------error checkers-----------------------------
 	// these all throw a QString containing the error message if an error is found
 	// all error messages contain the string "error" in them
-	// these functions are solely called by on_equals() and on_unary()
-	// which wrap them in try catch blocks to handle the error messages
+	// these functions are solely called by on_equals(), on_unary(), macros
+	// and repeats, which wrap them in try catch blocks to handle the messages
+	// check_number_error() is public and also used by the statistics panel
 	// checks for errors regarding invalid inputs to the binary operator
-	void check_binary_error(const double up, const double lo);
+	void check_binary_error(const char binary_op, const double up, 
+							const double lo);
 	// checks for errors regarding invalid inputs to the unary operator
 	void check_unary_error(const char unary_op, const double value);
-	// checks for value equaling inf, -inf, or nan
-	void check_number_error(const QString &value);
 	
 	//----------------------------undo functions-----------------------------
 	// appends the given event to the event list for the current frame
 	// also updates old mem values and old unary values
 	void add_event(const char event);
+	// returns the frame events are currently added to
+	EventFrame &current_frame();
+	// returns the events of the current frame
+	std::string_view current_events();
+	// starts a new frame with the given value
+	void push_frame(QStringView value, const Repeat &repeat = Repeat());
 	// updates the old value variables based on the last event
 	void remove_old_values(const char last_event);
 	// sets the state of the calculator to that of the last event frame
@@ -157,8 +420,13 @@ private:
 	// requires active_display has been set to the default value
 	// takes display_events, finds the most recent event that triggered overwrite,
 	// updates the display to that point, then redoes all events after that point
-	void reset_active_display(QString &display_events, const int unary_offset,
-							  const int mem_offset);
+	void reset_active_display(std::string_view display_events, 
+							  const int unary_offset, const int mem_offset);
+	
+	//-----------------------------state export------------------------------
+	// publishes the displays, memories, and flags for other processes
+	// event is added to the published events unless it is '\0'
+	void publish_state(const char event);
 	
 	//------------------------------debuggers--------------------------------
 	// prints recent events, current displays, flags, and mem values
@@ -0,0 +1,21 @@
+# the calculator's sources without main.cpp, shared by the app and the tests
+QT += widgets
+CONFIG += c++17
+# print the calculator state to stdout in debug builds
+CONFIG(debug, debug|release): DEFINES += CALC_DEBUG
+
+INCLUDEPATH += $$PWD
+SOURCES += $$PWD/calculator.cpp $$PWD/calcdisplay.cpp \
+	$$PWD/calcstats.cpp $$PWD/statspanel.cpp \
+	$$PWD/calcengine.cpp $$PWD/graphpanel.cpp $$PWD/historypanel.cpp \
+	$$PWD/rpnstack.cpp $$PWD/calcmatrix.cpp $$PWD/matrixpanel.cpp \
+	$$PWD/stateexport.cpp $$PWD/sessiontabs.cpp $$PWD/resultcache.cpp
+HEADERS += $$PWD/calculator.h $$PWD/calcbutton.h $$PWD/calclabel.h \
+	$$PWD/calcdisplay.h $$PWD/displaytext.h \
+	$$PWD/calcstats.h $$PWD/statspanel.h \
+	$$PWD/calccore.h $$PWD/calcengine.h $$PWD/graphpanel.h \
+	$$PWD/historypanel.h $$PWD/rpnstack.h \
+	$$PWD/calcmatrix.h $$PWD/matrixpanel.h $$PWD/calcshm.h \
+	$$PWD/stateexport.h $$PWD/sessiontabs.h $$PWD/resultcache.h
+# the state export uses POSIX shared memory
+linux: LIBS += -lrt
@@ -1,9 +1,7 @@
 TEMPLATE = app
 
-QT += widgets
-
-SOURCES += main.cpp calculator.cpp
-HEADERS += calculator.h calcbutton.h calclabel.h
+include(calculator.pri)
+SOURCES += main.cpp
 
 MOC_DIR = build
 OBJECTS_DIR = build
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+
+// a short utf-16 string stored inline, so editing a display never allocates
+// MAX_LENGTH covers every number, error message and memory value displayed,
+// longer strings are truncated
+class DisplayText {
+public:
+	static constexpr int MAX_LENGTH = 32;
+
+	constexpr DisplayText() {}
+	DisplayText(QStringView str) {
+		length = (str.size() < MAX_LENGTH) ? int(str.size()) : MAX_LENGTH;
+		for (int i = 0; i < length; ++i)
+			chars[i] = str[i].unicode();
+	}
+	template <int N>
+	constexpr DisplayText(const char16_t (&str)[N]) {
+		length = N - 1;
+		for (int i = 0; i < length; ++i)
+			chars[i] = str[i];
+	}
+
+	// from a nul terminated latin-1 string, such as an error message
+	static constexpr DisplayText from_latin1(const char *str) {
+		DisplayText text;
+		for (; *str != '\0'; ++str)
+			text.append(static_cast<unsigned char>(*str));
+		return text;
+	}
+
+	QStringView view() const {
+		return QStringView(chars, length);
+	}
+	operator QStringView() const {
+		return view();
+	}
+	QString to_string() const {
+		return QString(reinterpret_cast<const QChar *>(chars), length);
+	}
+
+	//--------------------------------queries--------------------------------
+	constexpr int size() const {
+		return length;
+	}
+	constexpr bool is_empty() const {
+		return length == 0;
+	}
+	constexpr char16_t operator[](const int index) const {
+		return chars[index];
+	}
+	// returns the index of the first c at or after from, or -1
+	constexpr int index_of(const char16_t c, const int from = 0) const {
+		for (int i = from; i < length; ++i) {
+			if (chars[i] == c)
+				return i;
+		}
+		return -1;
+	}
+	constexpr bool contains(const char16_t c) const {
+		return index_of(c) != -1;
+	}
+	constexpr bool starts_with(const char16_t c) const {
+		return length > 0 && chars[0] == c;
+	}
+	constexpr bool ends_with(const DisplayText &suffix) const {
+		if (suffix.length > length)
+			return false;
+		for (int i = 0; i < suffix.length; ++i) {
+			if (chars[length - suffix.length + i] != suffix.chars[i])
+				return false;
+		}
+		return true;
+	}
+	constexpr bool operator==(const DisplayText &other) const {
+		if (length != other.length)
+			return false;
+		for (int i = 0; i < length; ++i) {
+			if (chars[i] != other.chars[i])
+				return false;
+		}
+		return true;
+	}
+	constexpr bool operator!=(const DisplayText &other) const {
+		return !(*this == other);
+	}
+
+	//--------------------------------editing--------------------------------
+	// these silently do nothing when they would overflow the buffer
+	constexpr void append(const char16_t c) {
+		if (length < MAX_LENGTH)
+			chars[length++] = c;
+	}
+	constexpr void prepend(const char16_t c) {
+		if (length == MAX_LENGTH)
+			return;
+		for (int i = length; i > 0; --i)
+			chars[i] = chars[i - 1];
+		chars[0] = c;
+		++length;
+	}
+	constexpr void remove(const int index) {
+		for (int i = index; i + 1 < length; ++i)
+			chars[i] = chars[i + 1];
+		--length;
+	}
+	constexpr void set(const int index, const char16_t c) {
+		chars[index] = c;
+	}
+	constexpr void clear() {
+		length = 0;
+	}
+
+private:
+	char16_t chars[MAX_LENGTH] = {};
+	int length = 0;
+};
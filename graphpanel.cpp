@@ -0,0 +1,337 @@
+#include "graphpanel.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// samples are evaluated in chunks this size, small enough to stay in cache
+static const int CHUNK_SIZE = 256;
+// below this many samples evaluating on one thread is faster
+static const int MIN_PARALLEL = 1 << 14;
+// resample() keeps grid indices below this, 2^62, so they fit in a long long
+static const double MAX_INDEX = 4611686018427387904.0;
+
+// a / b rounded up, for b > 0
+static long long ceil_div(const long long a, const long long b) {
+	return a / b + (a % b > 0);
+}
+
+//----------------------------constructor----------------------------
+
+GraphPanel::GraphPanel(QWidget *parent) : QWidget(parent, Qt::Tool) {
+	setWindowTitle("graph");
+	setCursor(Qt::OpenHandCursor);
+	setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+QSize GraphPanel::sizeHint() const {
+	return QSize(400, 300);
+}
+
+// plots steps, keeping the current view
+void GraphPanel::plot(const QString &name, const QVector<CalcStep> &steps_in) {
+	steps = steps_in;
+	samples_valid = false;
+	setWindowTitle("graph: " + name);
+	view_changed();
+	fit_y();
+	update();
+}
+
+//------------------------------sampling-----------------------------
+
+// call after changing the x range
+void GraphPanel::view_changed() {
+	resample();
+	decimate();
+}
+
+// resamples the view, reusing samples from the previous grid
+// the grid spacing is the power of two giving about TARGET_SAMPLES samples
+// samples are moved within the same vector, so once it has grown to the
+// largest view resampling doesn't allocate
+void GraphPanel::resample() {
+	const double span = x_max - x_min;
+	int level = 0;
+	if (span > 0 && std::isfinite(span))
+		level = std::floor(std::log2(span / TARGET_SAMPLES));
+	double step = std::ldexp(1.0, level);
+	// a view too narrow for where it is has grid indices that don't fit in
+	// a long long, so nothing is plotted until it's zoomed back out
+	if (!(span > 0 && std::fabs(x_min / step) < MAX_INDEX 
+		  && std::fabs(x_max / step) < MAX_INDEX)) {
+		samples.clear();
+		samples_valid = false;
+		return;
+	}
+	long long first = std::floor(x_min / step);
+	long long last = std::ceil(x_max / step);
+	long long count = last - first + 1;
+	long long old_count = samples.size();
+	long long old_last = sample_first + old_count;
+	
+	// old step = new step * 2^shift
+	int shift = sample_level - level;
+	missing.clear();
+	missing_xs.clear();
+	auto add_missing = [&](long long i) {
+		missing.push_back(i);
+		missing_xs.push_back((first + i) * step);
+	};
+	if (!samples_valid || std::abs(shift) > 30) {
+		// nothing to reuse, evaluate the whole grid in place
+		samples.resize(count);
+		for (long long i = 0; i < count; ++i)
+			samples[i] = (first + i) * step;
+		evaluate(samples);
+	} else if (shift == 0) {
+		// panning, move the overlap to its new position and evaluate the
+		// edges
+		long long overlap_first = std::max(first, sample_first);
+		long long overlap_last = std::min(last + 1, old_last);
+		samples.resize(std::max(count, old_count));
+		if (overlap_first < overlap_last) {
+			auto from = samples.begin() + (overlap_first - sample_first);
+			auto to = samples.begin() + (overlap_first - first);
+			auto from_end = from + (overlap_last - overlap_first);
+			if (to < from)
+				std::copy(from, from_end, to);
+			else if (to > from)
+				std::copy_backward(from, from_end, 
+								   to + (overlap_last - overlap_first));
+		} else {
+			overlap_first = overlap_last = last + 1;
+		}
+		samples.resize(count);
+		for (long long i = 0; i < overlap_first - first; ++i)
+			add_missing(i);
+		for (long long i = overlap_last - first; i < count; ++i)
+			add_missing(i);
+	} else {
+		// zooming, every old sample still in view lands on the new grid
+		// new and old positions both increase with the index, so samples
+		// moving down are moved in increasing order and samples moving up
+		// in decreasing order, each before its slot is overwritten
+		long long ratio = 1LL << std::abs(shift);
+		// zooming out, the indices whose old index is in the old grid,
+		// found before multiplying so it can't overflow
+		long long in_old_first = ceil_div(sample_first, ratio);
+		long long in_old_last = ceil_div(old_last, ratio);
+		auto old_position = [&](long long i) {
+			long long index = first + i;
+			if (shift > 0) {
+				if (index % ratio != 0)
+					return -1LL;
+				index /= ratio;
+			} else {
+				if (index < in_old_first || index >= in_old_last)
+					return -1LL;
+				index *= ratio;
+			}
+			if (index < sample_first || index >= old_last)
+				return -1LL;
+			return index - sample_first;
+		};
+		samples.resize(std::max(count, old_count));
+		for (long long i = 0; i < count; ++i) {
+			long long old = old_position(i);
+			if (old >= i)
+				samples[i] = samples[old];
+		}
+		for (long long i = count - 1; i >= 0; --i) {
+			long long old = old_position(i);
+			if (old >= 0 && old < i)
+				samples[i] = samples[old];
+			else if (old < 0)
+				add_missing(i);
+		}
+		samples.resize(count);
+	}
+	
+	evaluate(missing_xs);
+	for (std::size_t k = 0; k < missing.size(); ++k)
+		samples[missing[k]] = missing_xs[k];
+	sample_first = first;
+	sample_level = level;
+	samples_valid = true;
+}
+
+// evaluates f at each x in xs, replacing them with the results
+// splits the work across cores in chunks
+void GraphPanel::evaluate(std::vector<double> &xs) {
+	auto evaluate_range = [this, &xs](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; i += CHUNK_SIZE) {
+			int count = std::min<std::size_t>(CHUNK_SIZE, end - i);
+			evaluate_steps(steps.constData(), steps.size(), &xs[i], count);
+		}
+	};
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	if (xs.size() < MIN_PARALLEL || threads == 1) {
+		evaluate_range(0, xs.size());
+		return;
+	}
+	// split on chunk boundaries
+	std::size_t chunks = (xs.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t) {
+		std::size_t begin = std::min(xs.size(), chunks * t / threads * CHUNK_SIZE);
+		std::size_t end = std::min(xs.size(), 
+								   chunks * (t + 1) / threads * CHUNK_SIZE);
+		workers.emplace_back(evaluate_range, begin, end);
+	}
+	evaluate_range(0, std::min(xs.size(), chunks / threads * CHUNK_SIZE));
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+// recomputes column_min and column_max from samples
+// nan samples are gaps, a column with only gaps stays nan
+void GraphPanel::decimate() {
+	int columns = width();
+	column_min.assign(columns, NAN);
+	column_max.assign(columns, NAN);
+	if (samples.empty())
+		return;
+	double step = std::ldexp(1.0, sample_level);
+	long long sample_count = samples.size();
+	
+	for (int c = 0; c < columns; ++c) {
+		long long begin = std::ceil(to_x(c) / step) - sample_first;
+		long long end = std::ceil(to_x(c + 1) / step) - sample_first;
+		begin = std::clamp(begin, 0LL, sample_count - 1);
+		end = std::clamp(end, begin + 1, sample_count);
+		double low = INFINITY;
+		double high = -INFINITY;
+		for (long long i = begin; i < end; ++i) {
+			// comparisons with nan are false, so gaps are skipped
+			if (samples[i] < low)
+				low = samples[i];
+			if (samples[i] > high)
+				high = samples[i];
+		}
+		if (low <= high) {
+			column_min[c] = low;
+			column_max[c] = high;
+		}
+	}
+}
+
+// sets the y range to the visible samples
+void GraphPanel::fit_y() {
+	double low = INFINITY;
+	double high = -INFINITY;
+	for (std::size_t c = 0; c < column_min.size(); ++c) {
+		if (std::isnan(column_min[c]))
+			continue;
+		low = std::min(low, column_min[c]);
+		high = std::max(high, column_max[c]);
+	}
+	if (low > high)
+		return;
+	if (low == high) {
+		low -= 1;
+		high += 1;
+	}
+	double pad = (high - low) * 0.05;
+	y_min = low - pad;
+	y_max = high + pad;
+}
+
+//-----------------------------coordinates---------------------------
+
+double GraphPanel::to_x(const double pixel) const {
+	return x_min + (x_max - x_min) * pixel / width();
+}
+
+double GraphPanel::to_y(const double pixel) const {
+	return y_max - (y_max - y_min) * pixel / height();
+}
+
+double GraphPanel::from_x(const double x) const {
+	return (x - x_min) / (x_max - x_min) * width();
+}
+
+double GraphPanel::from_y(const double y) const {
+	double pixel = (y_max - y) / (y_max - y_min) * height();
+	// keep far away points from overflowing the painter's coordinates
+	return std::clamp(pixel, -1.0 * height(), 2.0 * height());
+}
+
+//------------------------------painting-----------------------------
+
+void GraphPanel::paintEvent(QPaintEvent *) {
+	QPainter painter(this);
+	painter.fillRect(rect(), palette().brush(QPalette::Base));
+	
+	// axes
+	painter.setPen(palette().color(QPalette::Mid));
+	if (x_min < 0 && x_max > 0)
+		painter.drawLine(QPointF(from_x(0), 0), QPointF(from_x(0), height()));
+	if (y_min < 0 && y_max > 0)
+		painter.drawLine(QPointF(0, from_y(0)), QPointF(width(), from_y(0)));
+	
+	// each column is a vertical stroke from its max to its min,
+	// consecutive columns are joined, and gaps break the line
+	painter.setPen(palette().color(QPalette::Text));
+	QPolygonF run;
+	for (std::size_t c = 0; c < column_min.size(); ++c) {
+		if (std::isnan(column_min[c])) {
+			painter.drawPolyline(run);
+			run.clear();
+			continue;
+		}
+		run << QPointF(c + 0.5, from_y(column_max[c]))
+			<< QPointF(c + 0.5, from_y(column_min[c]));
+	}
+	painter.drawPolyline(run);
+}
+
+void GraphPanel::resizeEvent(QResizeEvent *) {
+	decimate();
+}
+
+//---------------------------mouse controls--------------------------
+
+void GraphPanel::mousePressEvent(QMouseEvent *event) {
+	drag_start = event->pos();
+	drag_x_min = x_min;
+	drag_x_max = x_max;
+	drag_y_min = y_min;
+	drag_y_max = y_max;
+}
+
+void GraphPanel::mouseMoveEvent(QMouseEvent *event) {
+	if (!(event->buttons() & Qt::LeftButton))
+		return;
+	QPoint moved = event->pos() - drag_start;
+	double dx = (drag_x_max - drag_x_min) * moved.x() / width();
+	double dy = (drag_y_max - drag_y_min) * moved.y() / height();
+	x_min = drag_x_min - dx;
+	x_max = drag_x_max - dx;
+	y_min = drag_y_min + dy;
+	y_max = drag_y_max + dy;
+	view_changed();
+	update();
+}
+
+void GraphPanel::mouseDoubleClickEvent(QMouseEvent *) {
+	fit_y();
+	update();
+}
+
+// zooms by a factor of two, keeping the point under the cursor in place
+void GraphPanel::wheelEvent(QWheelEvent *event) {
+	double factor = (event->angleDelta().y() > 0) ? 0.5 : 2;
+	double x = to_x(event->position().x());
+	double y = to_y(event->position().y());
+	x_min = x + (x_min - x) * factor;
+	x_max = x + (x_max - x) * factor;
+	y_min = y + (y_min - y) * factor;
+	y_max = y + (y_max - y) * factor;
+	view_changed();
+	update();
+}
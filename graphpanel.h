@@ -0,0 +1,77 @@
+#pragma once
+
+#include "calcengine.h"
+#include <QWidget>
+#include <QVector>
+#include <vector>
+
+// a tool window plotting y = f(x), where f is a list of calculator steps
+// samples lie on a grid of x = index * 2^level, so panning and zooming by
+// powers of two reuse every sample still in view and only evaluate new ones
+// samples are decimated to a min and max per pixel column for drawing
+class GraphPanel : public QWidget {
+public:
+	GraphPanel(QWidget *parent);
+
+	// plots steps, keeping the current view
+	void plot(const QString &name, const QVector<CalcStep> &steps_in);
+
+	QSize sizeHint() const;
+
+protected:
+	void paintEvent(QPaintEvent *event);
+	void resizeEvent(QResizeEvent *event);
+	// dragging pans, the wheel zooms by a factor of two around the cursor
+	// double clicking fits the y range to the visible samples
+	void mousePressEvent(QMouseEvent *event);
+	void mouseMoveEvent(QMouseEvent *event);
+	void mouseDoubleClickEvent(QMouseEvent *event);
+	void wheelEvent(QWheelEvent *event);
+
+private:
+	QVector<CalcStep> steps;
+
+	// the visible range
+	double x_min = -10;
+	double x_max = 10;
+	double y_min = -10;
+	double y_max = 10;
+
+	// how many samples to keep across the view, more than any screen is wide
+	const double TARGET_SAMPLES = 1 << 20;
+	// samples[i] is f(x) for x = (sample_first + i) * 2^sample_level
+	// nan where f has an error
+	std::vector<double> samples;
+	long long sample_first = 0;
+	int sample_level = 0;
+	bool samples_valid = false;
+	// the positions in samples resample() evaluates, and their x values
+	// kept between calls, like samples, so panning doesn't allocate
+	std::vector<long long> missing;
+	std::vector<double> missing_xs;
+
+	// the min and max sample in each pixel column, nan if there are none
+	std::vector<double> column_min;
+	std::vector<double> column_max;
+
+	// resamples the view, reusing samples from the previous grid
+	void resample();
+	// evaluates f at each x in xs, replacing them with the results
+	// splits the work across cores in chunks
+	void evaluate(std::vector<double> &xs);
+	// recomputes column_min and column_max from samples
+	void decimate();
+	// sets the y range to the visible samples
+	void fit_y();
+	// call after changing the x range
+	void view_changed();
+
+	// converts between pixels and graph coordinates
+	double to_x(const double pixel) const;
+	double to_y(const double pixel) const;
+	double from_x(const double x) const;
+	double from_y(const double y) const;
+
+	QPoint drag_start;
+	double drag_x_min, drag_x_max, drag_y_min, drag_y_max;
+};
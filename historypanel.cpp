@@ -0,0 +1,179 @@
+#include "historypanel.h"
+#include "calculator.h"
+
+#include <QVBoxLayout>
+#include <QScrollBar>
+
+#include <algorithm>
+
+//----------------------------history model--------------------------
+
+HistoryModel::HistoryModel(Calculator *calc_in, QObject *parent)
+: QAbstractListModel(parent), calc(calc_in), 
+  row_count(calc_in->get_frame_count()), row_cache(CACHE_ROWS) {}
+
+int HistoryModel::rowCount(const QModelIndex &parent) const {
+	return parent.isValid() ? 0 : row_count;
+}
+
+QVariant HistoryModel::data(const QModelIndex &index, int role) const {
+	if (role != Qt::DisplayRole || !index.isValid())
+		return QVariant();
+	int row = index.row();
+	// undo can remove frames before the model has caught up
+	if (row >= calc->get_frame_count())
+		return QVariant();
+	if (QString *text = row_cache.object(row))
+		return *text;
+	QString *text = new QString(format_row(row));
+	// the cache takes ownership
+	row_cache.insert(row, text);
+	return *text;
+}
+
+// catches up with the calculator's frames after events
+// only inserts or removes rows at the end and refreshes the rows from
+// the one before first_changed, whose result is first_changed's value
+void HistoryModel::sync(const int first_changed) {
+	int frame_count = calc->get_frame_count();
+	if (frame_count > row_count) {
+		beginInsertRows(QModelIndex(), row_count, frame_count - 1);
+		row_count = frame_count;
+		endInsertRows();
+	} else if (frame_count < row_count) {
+		beginRemoveRows(QModelIndex(), frame_count, row_count - 1);
+		for (int row = frame_count; row < row_count; ++row)
+			row_cache.remove(row);
+		row_count = frame_count;
+		endRemoveRows();
+	}
+	int first_row = std::max(0, std::min(first_changed, row_count) - 1);
+	for (int row = first_row; row < row_count; ++row)
+		row_cache.remove(row);
+	if (first_row < row_count)
+		emit dataChanged(index(first_row), index(row_count - 1));
+}
+
+// how each event reads in the history, nullptr for events that aren't saved
+static const char *event_text(const char event) {
+	switch (event) {
+		case '+':
+			return " + ";
+		case '-':
+			return " − ";
+		case 'x':
+			return " × ";
+		case 'd':
+			return " ÷ ";
+		case '^':
+			return " ^ ";
+		case 'l':
+			return " log ";
+		case 'm':
+			return " mod ";
+		case 'r':
+			return " √";
+		case 'i':
+			return " 1/x";
+		case '!':
+			return "!";
+		case 's':
+			return "±";
+		case 'e':
+			return "e";
+		case 'M':
+			return " M1 ";
+		case 'W':
+			return " M2 ";
+		case 'v':
+			return " ↵ ";
+	}
+	return nullptr;
+}
+
+// formats a frame as its entry value, its events and its result
+// the result of a frame is the entry value of the next one
+QString HistoryModel::format_row(const int row) const {
+	QString text = calc->get_frame_value(row);
+	std::string_view events = calc->get_frame_events(row);
+	if (!events.empty())
+		text += "   ";
+	for (char event : events) {
+		const char *event_str = event_text(event);
+		if (event_str)
+			text += QString::fromUtf8(event_str);
+		else
+			text += QLatin1Char(event);
+	}
+	if (row + 1 < row_count && row + 1 < calc->get_frame_count())
+		text += "   = " + calc->get_frame_value(row + 1);
+	return text;
+}
+
+//----------------------------history panel--------------------------
+
+HistoryPanel::HistoryPanel(Calculator *calc_in)
+: QWidget(calc_in, Qt::Tool), calc(calc_in) {
+	setWindowTitle("history");
+	
+	model = new HistoryModel(calc, this);
+	list = new QListView(this);
+	list->setModel(model);
+	list->setUniformItemSizes(true);
+	list->setLayoutMode(QListView::Batched);
+	list->setSelectionMode(QAbstractItemView::SingleSelection);
+	// keep key presses going to the calculator
+	list->setFocusPolicy(Qt::NoFocus);
+	connect(list, SIGNAL(clicked(const QModelIndex &)), 
+			this, SLOT(recall_row(const QModelIndex &)));
+	
+	sync_timer = new QTimer(this);
+	sync_timer->setInterval(16);
+	connect(sync_timer, SIGNAL(timeout()), this, SLOT(poll_changes()));
+	
+	QVBoxLayout *vbox = new QVBoxLayout;
+	vbox->addWidget(list);
+	setLayout(vbox);
+	resize(300, 400);
+}
+
+// call whenever the calculator's frames or their events change
+// only records it, so the keystroke path doesn't touch the model
+void HistoryPanel::frames_changed(const int frame) {
+	first_changed = std::min(first_changed, frame);
+}
+
+// catch up with the frames and start polling for changes
+void HistoryPanel::showEvent(QShowEvent *event) {
+	sync();
+	sync_timer->start();
+	QWidget::showEvent(event);
+}
+
+// stop polling, a hidden list doesn't need to follow the frames
+void HistoryPanel::hideEvent(QHideEvent *event) {
+	sync_timer->stop();
+	QWidget::hideEvent(event);
+}
+
+// called by sync_timer, syncs the model if the frames changed
+void HistoryPanel::poll_changes() {
+	if (first_changed != INT_MAX)
+		sync();
+}
+
+// catches the model up with the frames, keeping the newest row in
+// view if it already was
+void HistoryPanel::sync() {
+	bool at_end = list->verticalScrollBar()->value() 
+				  == list->verticalScrollBar()->maximum();
+	model->sync(first_changed);
+	first_changed = INT_MAX;
+	if (at_end && isVisible())
+		list->scrollToBottom();
+}
+
+// recalls the entry value of the clicked frame into the active display
+void HistoryPanel::recall_row(const QModelIndex &index) {
+	calc->recall_value(calc->get_frame_value(index.row()));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QWidget>
+#include <QAbstractListModel>
+#include <QListView>
+#include <QCache>
+#include <QString>
+#include <QTimer>
+#include <climits>
+
+class Calculator;
+
+// lists the calculator's event frames, one row per frame
+// rows are read from the calculator and formatted only when a view asks for
+// them, and the formatted strings are kept in a least recently used cache,
+// so the model costs the same for any number of frames
+class HistoryModel : public QAbstractListModel {
+public:
+	HistoryModel(Calculator *calc_in, QObject *parent);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role) const;
+
+	// catches up with the calculator's frames after events
+	// only inserts or removes rows at the end and refreshes the rows from
+	// the one before first_changed, whose result is first_changed's value
+	void sync(const int first_changed);
+
+private:
+	Calculator *calc;
+	// the frame count the view was last told about
+	int row_count = 0;
+	// formatted rows, at most CACHE_ROWS of them
+	const int CACHE_ROWS = 1024;
+	mutable QCache<int, QString> row_cache;
+
+	// formats a frame as its entry value, its events and its result
+	QString format_row(const int row) const;
+};
+
+// a tool window showing the history, clicking a row recalls its value
+// the list has uniform row heights, so it lays out in constant time
+class HistoryPanel : public QWidget {
+	Q_OBJECT
+
+public:
+	HistoryPanel(Calculator *calc_in);
+
+	// call whenever the calculator's frames from frame on change
+	// only records it, so the keystroke path doesn't touch the model
+	void frames_changed(const int frame);
+
+protected:
+	// catch up with the frames and start polling for changes
+	void showEvent(QShowEvent *event);
+	// stop polling, a hidden list doesn't need to follow the frames
+	void hideEvent(QHideEvent *event);
+
+private slots:
+	// recalls the entry value of the clicked frame into the active display
+	void recall_row(const QModelIndex &index);
+	// called by sync_timer, syncs the model if the frames changed
+	void poll_changes();
+
+private:
+	Calculator *calc;
+	HistoryModel *model;
+	QListView *list;
+	// the first frame changed since the model caught up, INT_MAX if none
+	int first_changed = INT_MAX;
+	// polls for changes about once a frame while the panel is shown
+	QTimer *sync_timer;
+
+	// catches the model up with the frames, keeping the newest row in
+	// view if it already was
+	void sync();
+};
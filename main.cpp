@@ -1,10 +1,10 @@
 #include <QApplication>
-#include "calculator.h"
+#include "sessiontabs.h"
 
 int main(int argc, char **argv) {
 	QApplication app(argc, argv);
 
-	Calculator window;
+	SessionTabs window;
 	window.setWindowTitle("calculator");
 	window.show();
 
@@ -0,0 +1,276 @@
+#include "matrixpanel.h"
+#include "calculator.h"
+
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QInputDialog>
+
+#include <algorithm>
+
+// the corner of the result that is shown
+static const int SHOWN_ROWS = 8;
+static const int SHOWN_COLS = 6;
+
+//----------------------------constructor----------------------------
+
+// builds the views and buttons, calc is used for number formatting
+MatrixPanel::MatrixPanel(Calculator *calc_in)
+: QWidget(calc_in, Qt::Tool), calc(calc_in) {
+	setWindowTitle("matrices");
+	
+	for (QLabel *&label : register_labels)
+		label = new QLabel(this);
+	
+	QHBoxLayout *a_row = new QHBoxLayout;
+	a_row->addWidget(register_labels[REGISTER_A], 1);
+	a_row->addWidget(new_button("load", SLOT(load_a())));
+	a_row->addWidget(new_button("enter", SLOT(enter_a())));
+	QHBoxLayout *b_row = new QHBoxLayout;
+	b_row->addWidget(register_labels[REGISTER_B], 1);
+	b_row->addWidget(new_button("load", SLOT(load_b())));
+	b_row->addWidget(new_button("enter", SLOT(enter_b())));
+	QHBoxLayout *result_row = new QHBoxLayout;
+	result_row->addWidget(register_labels[RESULT], 1);
+	result_row->addWidget(new_button("→ A", SLOT(result_to_a())));
+	
+	QFormLayout *registers_form = new QFormLayout;
+	registers_form->addRow("A", a_row);
+	registers_form->addRow("B", b_row);
+	registers_form->addRow("result", result_row);
+	
+	QHBoxLayout *ops = new QHBoxLayout;
+	ops->addWidget(new_button("A × B", SLOT(multiply())));
+	ops->addWidget(new_button("A + B", SLOT(add())));
+	ops->addWidget(new_button("A − B", SLOT(subtract())));
+	ops->addWidget(new_button("1/A", SLOT(invert())));
+	
+	result_view = new QPlainTextEdit(this);
+	result_view->setReadOnly(true);
+	result_view->setLineWrapMode(QPlainTextEdit::NoWrap);
+	// keep key presses going to the calculator
+	result_view->setFocusPolicy(Qt::NoFocus);
+	status_label = new QLabel(this);
+	
+	QVBoxLayout *vbox = new QVBoxLayout;
+	vbox->addLayout(registers_form);
+	vbox->addLayout(ops);
+	vbox->addWidget(result_view);
+	vbox->addWidget(status_label);
+	setLayout(vbox);
+	resize(400, 350);
+	
+	work_timer = new QTimer(this);
+	work_timer->setInterval(16);
+	connect(work_timer, SIGNAL(timeout()), this, SLOT(poll_work()));
+	
+	update_views();
+}
+
+// waits for running work
+MatrixPanel::~MatrixPanel() {
+	if (work_thread.joinable())
+		work_thread.join();
+}
+
+// adds a button running slot, disabled while work runs
+QPushButton *MatrixPanel::new_button(const QString &text, const char *slot) {
+	QPushButton *button = new QPushButton(text, this);
+	connect(button, SIGNAL(clicked()), this, slot);
+	// keep key presses going to the calculator
+	button->setFocusPolicy(Qt::NoFocus);
+	buttons.append(button);
+	return button;
+}
+
+//-----------------------------registers-----------------------------
+
+void MatrixPanel::load_a() {
+	load(REGISTER_A);
+}
+
+void MatrixPanel::load_b() {
+	load(REGISTER_B);
+}
+
+void MatrixPanel::enter_a() {
+	enter(REGISTER_A);
+}
+
+void MatrixPanel::enter_b() {
+	enter(REGISTER_B);
+}
+
+// memory maps a file with a row per line and reads it into target on
+// work_thread
+void MatrixPanel::load(const int target) {
+	QString path = QFileDialog::getOpenFileName(this, "load matrix");
+	if (path.isEmpty())
+		return;
+	work_source.setFileName(path);
+	if (!work_source.open(QIODevice::ReadOnly)) {
+		status_label->setText("file error");
+		return;
+	}
+	const qint64 size = work_source.size();
+	if (size == 0) {
+		work_source.close();
+		status_label->setText("no data error");
+		return;
+	}
+	const char *data = reinterpret_cast<const char *>(
+		work_source.map(0, size));
+	if (!data) {
+		work_source.close();
+		status_label->setText("file map error");
+		return;
+	}
+	start_work([data, size](Matrix &result) {
+		return parse_matrix(data, data + size, result);
+	}, target);
+}
+
+// asks for rows to type into target, typed matrices are small enough to
+// read right away
+void MatrixPanel::enter(const int target) {
+	bool ok = false;
+	QString text = QInputDialog::getMultiLineText(this, "enter matrix", 
+												  "one row per line:", 
+												  QString(), &ok);
+	if (!ok)
+		return;
+	QByteArray bytes = text.toUtf8();
+	Matrix matrix;
+	const char *error = parse_matrix(bytes.constData(), 
+									 bytes.constData() + bytes.size(), matrix);
+	if (error) {
+		status_label->setText(error);
+		return;
+	}
+	registers[target] = std::move(matrix);
+	status_label->clear();
+	update_views();
+}
+
+// copies the result into A, so operations can be chained
+void MatrixPanel::result_to_a() {
+	if (registers[RESULT].is_empty())
+		return;
+	registers[REGISTER_A] = registers[RESULT];
+	update_views();
+}
+
+//----------------------------operations-----------------------------
+// the registers can't change while work runs, since every button that
+// changes them is disabled, so the work reads them in place
+
+void MatrixPanel::multiply() {
+	const Matrix &a = registers[REGISTER_A];
+	const Matrix &b = registers[REGISTER_B];
+	start_work([&a, &b](Matrix &result) {
+		if (a.is_empty() || b.is_empty())
+			return "no data error";
+		return matrix_multiply(a, b, result);
+	}, RESULT);
+}
+
+void MatrixPanel::add() {
+	const Matrix &a = registers[REGISTER_A];
+	const Matrix &b = registers[REGISTER_B];
+	start_work([&a, &b](Matrix &result) {
+		if (a.is_empty() || b.is_empty())
+			return "no data error";
+		return matrix_add(a, b, result);
+	}, RESULT);
+}
+
+void MatrixPanel::subtract() {
+	const Matrix &a = registers[REGISTER_A];
+	const Matrix &b = registers[REGISTER_B];
+	start_work([&a, &b](Matrix &result) {
+		if (a.is_empty() || b.is_empty())
+			return "no data error";
+		return matrix_subtract(a, b, result);
+	}, RESULT);
+}
+
+void MatrixPanel::invert() {
+	const Matrix &a = registers[REGISTER_A];
+	start_work([&a](Matrix &result) {
+		if (a.is_empty())
+			return "no data error";
+		return matrix_inverse(a, result);
+	}, RESULT);
+}
+
+//--------------------------------work-------------------------------
+
+// runs work on work_thread, its result goes to the target register
+void MatrixPanel::start_work(const std::function<const char *(Matrix &)> &work,
+							 const int target) {
+	for (QPushButton *button : buttons)
+		button->setEnabled(false);
+	status_label->setText("working");
+	work_target = target;
+	work_done = false;
+	work_thread = std::thread([this, work] {
+		work_error = work(work_result);
+		work_done.store(true, std::memory_order_release);
+	});
+	work_timer->start();
+}
+
+// called by work_timer, stores the result once the work is done
+// an error leaves the registers as they were
+void MatrixPanel::poll_work() {
+	if (!work_done.load(std::memory_order_acquire))
+		return;
+	work_thread.join();
+	work_timer->stop();
+	work_source.close();
+	for (QPushButton *button : buttons)
+		button->setEnabled(true);
+	if (work_error) {
+		status_label->setText(work_error);
+	} else {
+		registers[work_target] = std::move(work_result);
+		status_label->clear();
+	}
+	work_result = Matrix();
+	update_views();
+}
+
+//------------------------------display------------------------------
+
+// rewrites the register labels and the result view
+// only the corner of the result that fits is formatted, however big it is
+void MatrixPanel::update_views() {
+	for (int i = 0; i < 3; ++i)
+		register_labels[i]->setText(describe(registers[i]));
+	
+	const Matrix &result = registers[RESULT];
+	const int rows = std::min(result.rows(), SHOWN_ROWS);
+	const int cols = std::min(result.cols(), SHOWN_COLS);
+	QString text;
+	for (int i = 0; i < rows; ++i) {
+		for (int j = 0; j < cols; ++j) {
+			if (j > 0)
+				text += "   ";
+			text += calc->double_to_string(result.at(i, j));
+		}
+		if (result.cols() > cols)
+			text += "   …";
+		text += '\n';
+	}
+	if (result.rows() > rows)
+		text += "⋮";
+	result_view->setPlainText(text);
+}
+
+// shows the size of a register, or that it is empty
+QString MatrixPanel::describe(const Matrix &matrix) {
+	if (matrix.is_empty())
+		return "empty";
+	return QString("%1 × %2").arg(matrix.rows()).arg(matrix.cols());
+}
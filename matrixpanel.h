@@ -0,0 +1,87 @@
+#pragma once
+
+#include "calcmatrix.h"
+#include <QWidget>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+class Calculator;
+
+// a tool window with the matrix registers A and B and the result of the
+// last operation on them, the scalar memories stay in the calculator
+// registers are loaded from a file or typed in a row per line
+class MatrixPanel : public QWidget {
+	Q_OBJECT
+
+public:
+	// builds the views and buttons, calc is used for number formatting
+	MatrixPanel(Calculator *calc_in);
+	// waits for running work
+	~MatrixPanel();
+
+private slots:
+	// memory maps a file with a row per line and reads it into a register
+	void load_a();
+	void load_b();
+	// asks for rows to type into a register
+	void enter_a();
+	void enter_b();
+	// these set the result to A × B, A + B, A − B, and A⁻¹
+	void multiply();
+	void add();
+	void subtract();
+	void invert();
+	// copies the result into A, so operations can be chained
+	void result_to_a();
+	// called by work_timer, stores the result once the work is done
+	void poll_work();
+
+private:
+	Calculator *calc;
+	// A, B, and the result of the last operation
+	static const int REGISTER_A = 0;
+	static const int REGISTER_B = 1;
+	static const int RESULT = 2;
+	Matrix registers[3];
+
+	QLabel *register_labels[3];
+	// shows the top left corner of the result
+	QPlainTextEdit *result_view;
+	// shows errors and whether work is running
+	QLabel *status_label;
+	// disabled while working
+	QVector<QPushButton *> buttons;
+
+	// loads and operations run on work_thread, so the window keeps
+	// responding to big matrices
+	std::thread work_thread;
+	// set by work_thread once work_result and work_error are written
+	std::atomic<bool> work_done{false};
+	Matrix work_result;
+	const char *work_error = nullptr;
+	// the register work_result goes to
+	int work_target = RESULT;
+	// the mapped file, kept until the load is done
+	QFile work_source;
+	// polls the work about once a frame
+	QTimer *work_timer;
+
+	// adds a button running slot, disabled while work runs
+	QPushButton *new_button(const QString &text, const char *slot);
+	void load(const int target);
+	void enter(const int target);
+	// runs work on work_thread, its result goes to the target register
+	void start_work(const std::function<const char *(Matrix &)> &work,
+					const int target);
+	// rewrites the register labels and the result view
+	void update_views();
+	// shows the size of a register, or that it is empty
+	QString describe(const Matrix &matrix);
+};
@@ -0,0 +1,131 @@
+#include "resultcache.h"
+
+#include <cstring>
+#include <type_traits>
+
+// entries hold the text as raw words
+static_assert(std::is_trivially_copyable_v<DisplayText>);
+
+//-------------------------------keys--------------------------------
+
+static uint64_t bits(const double value) {
+	uint64_t word;
+	std::memcpy(&word, &value, sizeof(word));
+	return word;
+}
+
+// picks the set of a key, mixing all the bits of both operands
+static int set_of(const char op, const uint64_t up, const uint64_t lo, 
+				  const int sets) {
+	uint64_t hash = (up ^ (lo * 0x9e3779b97f4a7c15)) + 
+					static_cast<unsigned char>(op);
+	hash ^= hash >> 32;
+	hash *= 0xd6e8feb86659fd93;
+	hash ^= hash >> 32;
+	return int(hash & (sets - 1));
+}
+
+//------------------------------lookups------------------------------
+
+// copies the result of op on up and lo into result on a hit
+// a miss should be followed by insert(), which a bypass doesn't need
+ResultCache::Lookup ResultCache::lookup(const char op, const double up, 
+										const double lo, 
+										CachedResult &result) {
+	const int left = bypass_left.load(std::memory_order_relaxed);
+	if (left > 0) {
+		bypass_left.store(left - 1, std::memory_order_relaxed);
+		bypassed.store(bypassed.load(std::memory_order_relaxed) + 1, 
+					   std::memory_order_relaxed);
+		return BYPASSED;
+	}
+	const uint64_t up_bits = bits(up);
+	const uint64_t lo_bits = bits(lo);
+	// op is never 0, so empty entries don't match
+	const uint64_t op_bits = static_cast<unsigned char>(op);
+	for (Entry &entry : entries[set_of(op, up_bits, lo_bits, SETS)]) {
+		const uint32_t version = entry.version.load(std::memory_order_acquire);
+		if (version % 2 == 1)
+			continue;
+		uint64_t words[WORDS];
+		for (int i = 0; i < 3; ++i)
+			words[i] = entry.words[i].load(std::memory_order_relaxed);
+		if (words[0] != op_bits || words[1] != up_bits || 
+			words[2] != lo_bits)
+			continue;
+		for (int i = 3; i < WORDS; ++i)
+			words[i] = entry.words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (entry.version.load(std::memory_order_relaxed) != version)
+			continue;
+		
+		std::memcpy(&result.value, &words[3], sizeof(result.value));
+		result.error = reinterpret_cast<const char *>(words[4]);
+		std::memcpy(static_cast<void *>(&result.text), &words[5], 
+					sizeof(result.text));
+		record(true);
+		return HIT;
+	}
+	record(false);
+	return MISS;
+}
+
+// stores the result of op on up and lo, replacing the oldest in its set
+// skipped if another thread is writing that entry
+void ResultCache::insert(const char op, const double up, const double lo,
+						 const CachedResult &result) {
+	const uint64_t up_bits = bits(up);
+	const uint64_t lo_bits = bits(lo);
+	const int set = set_of(op, up_bits, lo_bits, SETS);
+	const int way = next_way[set].fetch_add(1, std::memory_order_relaxed) % WAYS;
+	Entry &entry = entries[set][way];
+	
+	uint32_t version = entry.version.load(std::memory_order_relaxed);
+	if (version % 2 == 1 || 
+		!entry.version.compare_exchange_strong(version, version + 1, 
+											   std::memory_order_relaxed))
+		return;
+	std::atomic_thread_fence(std::memory_order_release);
+	
+	uint64_t words[WORDS] = { static_cast<unsigned char>(op), up_bits, lo_bits, 
+							  bits(result.value), 
+							  reinterpret_cast<uintptr_t>(result.error) };
+	std::memcpy(&words[5], &result.text, sizeof(result.text));
+	for (int i = 0; i < WORDS; ++i)
+		entry.words[i].store(words[i], std::memory_order_relaxed);
+	entry.version.store(version + 2, std::memory_order_release);
+}
+
+//------------------------------counters-----------------------------
+
+CacheCounters ResultCache::counters() const {
+	CacheCounters counters;
+	counters.hits = hits.load(std::memory_order_relaxed);
+	counters.misses = misses.load(std::memory_order_relaxed);
+	counters.bypassed = bypassed.load(std::memory_order_relaxed);
+	return counters;
+}
+
+// counts a lookup, and starts a bypass at the end of a poor window
+// the counts are only statistics, so they are updated without locked
+// instructions, threads racing on them can lose a few counts, which only
+// shifts when the next bypass starts
+void ResultCache::record(const bool hit) {
+	auto increment = [](auto &counter) {
+		counter.store(counter.load(std::memory_order_relaxed) + 1, 
+					  std::memory_order_relaxed);
+	};
+	if (hit) {
+		increment(hits);
+		increment(window_hits);
+	} else {
+		increment(misses);
+	}
+	increment(window_lookups);
+	if (window_lookups.load(std::memory_order_relaxed) < WINDOW)
+		return;
+	if (window_hits.load(std::memory_order_relaxed) < MIN_HITS)
+		bypass_left.store(BYPASS_CALLS, std::memory_order_relaxed);
+	window_lookups.store(0, std::memory_order_relaxed);
+	window_hits.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "displaytext.h"
+#include <atomic>
+#include <cstdint>
+
+// a result as the displays show it
+struct CachedResult {
+	// the result rounded like a display rounds it
+	double value = 0;
+	// the formatted result, or the error message
+	DisplayText text;
+	// the error message, or nullptr
+	const char *error = nullptr;
+};
+
+// hit and miss counts of a ResultCache, bypassed calls are neither
+struct CacheCounters {
+	long long hits = 0;
+	long long misses = 0;
+	long long bypassed = 0;
+};
+
+// remembers the results of the transcendental binary ops, keyed on the op
+// and the exact bits of both operands, for macros and repeats that keep
+// taking the same log or power
+// it is set associative with a few ways per set, and lock free: every entry
+// is a seqlock, a reader that overlaps a write misses, and a writer that
+// finds an entry being written skips the insert instead of waiting
+// when too few lookups hit to pay for the probes it is bypassed for a while
+class ResultCache {
+public:
+	// whether op is worth caching, the others are cheaper to calculate
+	static constexpr bool caches(const char op) {
+		return op == '^' || op == 'l';
+	}
+
+	enum Lookup { HIT, MISS, BYPASSED };
+	// copies the result of op on up and lo into result on a hit
+	// a miss should be followed by insert(), which a bypass doesn't need
+	Lookup lookup(const char op, const double up, const double lo,
+				  CachedResult &result);
+	// stores the result of op on up and lo, replacing the oldest in its set
+	void insert(const char op, const double up, const double lo,
+				const CachedResult &result);
+
+	CacheCounters counters() const;
+
+private:
+	static constexpr int SETS = 128;
+	static constexpr int WAYS = 4;
+	// the op, both operands, the value, the error, then the text
+	static constexpr int TEXT_WORDS = (sizeof(DisplayText) + 7) / 8;
+	static constexpr int WORDS = 5 + TEXT_WORDS;
+	struct alignas(64) Entry {
+		// odd while the entry is being written
+		std::atomic<uint32_t> version{0};
+		// all 0 in an empty entry, which no op matches
+		std::atomic<uint64_t> words[WORDS] = {};
+	};
+	Entry entries[SETS][WAYS];
+	// the way each set replaces next
+	std::atomic<uint8_t> next_way[SETS] = {};
+
+	// the hit rate is sampled over WINDOW lookups, below MIN_HITS of them
+	// the cache is bypassed for BYPASS_CALLS calls before sampling again
+	// a hit saves about three times what a missed probe and insert cost
+	static constexpr int WINDOW = 4096;
+	static constexpr int MIN_HITS = WINDOW / 4;
+	static constexpr int BYPASS_CALLS = 16 * WINDOW;
+	std::atomic<long long> hits{0};
+	std::atomic<long long> misses{0};
+	std::atomic<long long> bypassed{0};
+	std::atomic<int> window_lookups{0};
+	std::atomic<int> window_hits{0};
+	std::atomic<int> bypass_left{0};
+
+	// counts a lookup, and starts a bypass at the end of a poor window
+	void record(const bool hit);
+};
@@ -0,0 +1,109 @@
+#include "rpnstack.h"
+
+#include <algorithm>
+
+//------------------------------queries------------------------------
+
+int RpnStack::size() const {
+	return count;
+}
+
+// the entry level places below the top, level 0 is the top
+double RpnStack::at(const int level) const {
+	return entries[count - 1 - level];
+}
+
+//------------------------------changes------------------------------
+
+// pushes value on top
+bool RpnStack::push(const double value) {
+	if (count == CAPACITY)
+		return false;
+	entries[count++] = value;
+	log({ false, false, 0, 1, {} });
+	return true;
+}
+
+// removes the top entry
+bool RpnStack::drop() {
+	if (count == 0)
+		return false;
+	--count;
+	log({ false, false, 1, 0, { entries[count] } });
+	return true;
+}
+
+// replaces the top replaced entries with value, for the ops
+// only one or two entries are replaced, so the delta stays a fixed size
+bool RpnStack::replace(const int replaced, const double value) {
+	if (replaced < 1 || replaced > 2 || count < replaced)
+		return false;
+	Delta delta = { false, false, (unsigned char)replaced, 1, {} };
+	for (int i = 0; i < replaced; ++i)
+		delta.removed[i] = entries[count - replaced + i];
+	count -= replaced;
+	entries[count++] = value;
+	log(delta);
+	return true;
+}
+
+// exchanges the top two entries
+bool RpnStack::swap() {
+	if (count < 2)
+		return false;
+	log({ false, false, 2, 2, { entries[count - 2], entries[count - 1] } });
+	std::swap(entries[count - 2], entries[count - 1]);
+	return true;
+}
+
+// moves the top entry to the bottom, shifting the others up a level
+bool RpnStack::roll() {
+	if (count < 2)
+		return false;
+	std::rotate(entries, entries + count - 1, entries + count);
+	log({ true, false, 0, 0, {} });
+	return true;
+}
+
+// removes every entry, undone as a single change
+// logged as one drop per entry, at most CAPACITY deltas
+bool RpnStack::clear() {
+	if (count == 0)
+		return false;
+	for (bool joined = false; count > 0; joined = true) {
+		--count;
+		log({ false, joined, 1, 0, { entries[count] } });
+	}
+	return true;
+}
+
+//-------------------------------undo--------------------------------
+
+// reverts the most recent change, returns false if there is none left
+bool RpnStack::undo() {
+	if (delta_count == 0)
+		return false;
+	bool joined = true;
+	while (joined && delta_count > 0) {
+		delta_end = (delta_end + UNDO_CAPACITY - 1) % UNDO_CAPACITY;
+		--delta_count;
+		const Delta &delta = deltas[delta_end];
+		if (delta.rolled) {
+			std::rotate(entries, entries + 1, entries + count);
+		} else {
+			count -= delta.added_count;
+			for (int i = 0; i < delta.removed_count; ++i)
+				entries[count++] = delta.removed[i];
+		}
+		joined = delta.joined;
+	}
+	return true;
+}
+
+// adds delta to the ring
+void RpnStack::log(const Delta &delta) {
+	deltas[delta_end] = delta;
+	delta_end = (delta_end + 1) % UNDO_CAPACITY;
+	if (delta_count < UNDO_CAPACITY)
+		++delta_count;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// the operand stack for RPN mode
+// entries are stored inline with a fixed capacity, so pushing never
+// allocates, and every change is logged as a delta holding only the entries
+// it removed, so undoing costs the same however long the session has been
+class RpnStack {
+public:
+	// the most entries the stack holds
+	static constexpr int CAPACITY = 64;
+	// how many changes can be undone, older ones are forgotten
+	static constexpr int UNDO_CAPACITY = 1024;
+
+	int size() const;
+	// the entry level places below the top, level 0 is the top
+	double at(const int level) const;
+
+	// these return false and leave the stack unchanged if there aren't
+	// enough entries, or no room for the result
+	// pushes value on top
+	bool push(const double value);
+	// removes the top entry
+	bool drop();
+	// replaces the top replaced entries with value, for the ops
+	bool replace(const int replaced, const double value);
+	// exchanges the top two entries
+	bool swap();
+	// moves the top entry to the bottom, shifting the others up a level
+	bool roll();
+	// removes every entry, undone as a single change
+	bool clear();
+	// reverts the most recent change, returns false if there is none left
+	bool undo();
+
+private:
+	// entries[0] is the bottom, only the first count are in use
+	double entries[CAPACITY];
+	int count = 0;
+
+	// a change that popped removed_count entries, then pushed added_count
+	// undoing it pops the added entries and pushes the removed ones back
+	// a roll is undone by rolling the other way instead
+	struct Delta {
+		bool rolled;
+		// set on all but the first delta of a clear, so they undo together
+		bool joined;
+		unsigned char removed_count;
+		unsigned char added_count;
+		double removed[2];
+	};
+	// a ring of the most recent deltas, the oldest is overwritten when full
+	Delta deltas[UNDO_CAPACITY];
+	int delta_end = 0;
+	int delta_count = 0;
+
+	// adds delta to the ring
+	void log(const Delta &delta);
+};
@@ -0,0 +1,56 @@
+#include "sessiontabs.h"
+#include "calculator.h"
+
+//----------------------------constructor----------------------------
+
+// opens the first session
+SessionTabs::SessionTabs(QWidget *parent) : QTabWidget(parent) {
+	setTabsClosable(true);
+	setDocumentMode(true);
+	
+	new_button = new QToolButton(this);
+	new_button->setText("+");
+	new_button->setFocusPolicy(Qt::NoFocus);
+	setCornerWidget(new_button, Qt::TopRightCorner);
+	
+	connect(new_button, SIGNAL(clicked()), this, SLOT(new_session()));
+	connect(this, SIGNAL(tabCloseRequested(int)), 
+			this, SLOT(close_session(int)));
+	connect(this, SIGNAL(currentChanged(int)), this, SLOT(focus_session()));
+	new_session();
+}
+
+//------------------------------sessions-----------------------------
+
+// opens a session in a new tab and switches to it
+void SessionTabs::new_session() {
+	const int session = next_session++;
+	Calculator *calc = new Calculator(session, this);
+	calc->setWindowTitle(QString::number(session + 1));
+	connect(calc, SIGNAL(windowTitleChanged(QString)), 
+			this, SLOT(update_tab_title(QString)));
+	setCurrentIndex(addTab(calc, calc->windowTitle()));
+}
+
+// closes the session in the tab at index, freeing all of its state
+// deleting the calculator stops its task and releases its arena at once
+void SessionTabs::close_session(const int index) {
+	if (count() == 1)
+		return;
+	QWidget *calc = widget(index);
+	removeTab(index);
+	delete calc;
+}
+
+// gives the shown session keyboard focus
+void SessionTabs::focus_session() {
+	if (currentWidget())
+		currentWidget()->setFocus();
+}
+
+// shows a session's window title in its tab, it marks recording
+void SessionTabs::update_tab_title(const QString &title) {
+	int index = indexOf(qobject_cast<QWidget *>(sender()));
+	if (index != -1)
+		setTabText(index, title);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QTabWidget>
+#include <QToolButton>
+
+// the main window, with a tab for each calculation open at once
+// every tab is a separate Calculator with its own displays, memories, undo
+// history and arena, so switching tabs only shows another page
+class SessionTabs : public QTabWidget {
+	Q_OBJECT
+
+public:
+	// opens the first session
+	SessionTabs(QWidget *parent = 0);
+
+private slots:
+	// opens a session in a new tab and switches to it
+	void new_session();
+	// closes the session in the tab at index, freeing all of its state
+	// the last session stays open
+	void close_session(const int index);
+	// gives the shown session keyboard focus
+	void focus_session();
+	// shows a session's window title in its tab, it marks recording
+	void update_tab_title(const QString &title);
+
+private:
+	QToolButton *new_button;
+	// numbers sessions in the order they are opened, for their tab titles
+	// and shared memory segments
+	int next_session = 0;
+};
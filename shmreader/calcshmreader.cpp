@@ -0,0 +1,210 @@
+#include "calcshmreader.h"
+
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------setup------------------------------
+
+// unmaps the segment
+CalcStateReader::~CalcStateReader() {
+	close();
+}
+
+#ifdef __linux__
+// maps size bytes of the segment name, nullptr if it can't or it is smaller
+static void *map_segment(const std::string &name, const size_t size, 
+						 const bool writable) {
+	int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+	if (fd == -1)
+		return nullptr;
+	struct stat info;
+	void *memory = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size >= off_t(size)) {
+		memory = mmap(nullptr, size, 
+					  writable ? PROT_READ | PROT_WRITE : PROT_READ, 
+					  MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	return (memory == MAP_FAILED) ? nullptr : memory;
+}
+#endif
+
+// maps the segment name, returns false if no calculator has created it or
+// it has a different layout version
+// the state is mapped read only, only the waiters segment is writable, and
+// without it wait() still works but polls
+bool CalcStateReader::open(const std::string &name) {
+	close();
+#ifdef __linux__
+	void *memory = map_segment(name, sizeof(CalcShmSegment), false);
+	if (!memory)
+		return false;
+	segment = static_cast<const CalcShmSegment *>(memory);
+	// the magic is written last, once the header is set up
+	bool ready = segment->magic == CALC_SHM_MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!ready || segment->version != CALC_SHM_VERSION) {
+		close();
+		return false;
+	}
+	waiters = static_cast<CalcShmWaiters *>(map_segment(
+		name + CALC_SHM_WAITERS_SUFFIX, sizeof(CalcShmWaiters), true));
+	return true;
+#else
+	(void)name;
+	return false;
+#endif
+}
+
+void CalcStateReader::close() {
+#ifdef __linux__
+	if (segment)
+		munmap(const_cast<CalcShmSegment *>(segment), sizeof(CalcShmSegment));
+	if (waiters)
+		munmap(waiters, sizeof(CalcShmWaiters));
+#endif
+	segment = nullptr;
+	waiters = nullptr;
+}
+
+bool CalcStateReader::is_open() const {
+	return segment != nullptr;
+}
+
+// true once the calculator has exited
+bool CalcStateReader::is_closed() const {
+	return segment && segment->closed.load(std::memory_order_acquire);
+}
+
+// the names of the state segments of running calculators, sorted
+// found in /dev/shm like the calculator finds stale segments, but keeping
+// the segments whose process is still running and skipping waiters
+std::vector<std::string> list_calc_segments() {
+	std::vector<std::string> names;
+#ifdef __linux__
+	DIR *dir = opendir("/dev/shm");
+	if (!dir)
+		return names;
+	const size_t suffix_length = std::strlen(CALC_SHM_WAITERS_SUFFIX);
+	while (dirent *entry = readdir(dir)) {
+		const long pid = calc_shm_pid(entry->d_name);
+		if (pid == 0 || (kill(pid, 0) == -1 && errno == ESRCH))
+			continue;
+		const std::string name = "/" + std::string(entry->d_name);
+		if (name.size() >= suffix_length 
+			&& name.compare(name.size() - suffix_length, suffix_length, 
+							CALC_SHM_WAITERS_SUFFIX) == 0) {
+			continue;
+		}
+		names.push_back(name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+#endif
+	return names;
+}
+
+//--------------------------------state------------------------------
+
+// changes with every publish, pass it to wait()
+uint32_t CalcStateReader::sequence() const {
+	return segment ? segment->sequence.load(std::memory_order_acquire) : 0;
+}
+
+// copies the state published last, returns false if not open
+// retries while the calculator is writing it, which only takes as long as
+// copying a few hundred bytes
+bool CalcStateReader::read(CalcShmState &state) const {
+	if (!segment)
+		return false;
+	while (true) {
+		const uint32_t before = segment->sequence.load(std::memory_order_acquire);
+		if (before % 2 == 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		std::memcpy(&state, &segment->state, sizeof(state));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (segment->sequence.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+}
+
+// blocks until the sequence is no longer sequence, or timeout_ms passes
+// a wake up without a change, or a signal, also returns early, so callers
+// wait in a loop
+// the futex wait works on the read only mapping, but the calculator only
+// wakes counted waiters, so an uncounted one wakes itself every POLL_MS
+bool CalcStateReader::wait(const uint32_t sequence, const int timeout_ms) const {
+	if (!segment)
+		return false;
+#ifdef __linux__
+	static const int POLL_MS = 10;
+	int wait_ms = timeout_ms;
+	if (!waiters && (wait_ms < 0 || wait_ms > POLL_MS))
+		wait_ms = POLL_MS;
+	// counted before checking the sequence, see StateExport::publish()
+	if (waiters)
+		waiters->waiters.fetch_add(1, std::memory_order_seq_cst);
+	if (segment->sequence.load(std::memory_order_seq_cst) == sequence) {
+		timespec timeout = { wait_ms / 1000, (wait_ms % 1000) * 1000000L };
+		syscall(SYS_futex, &segment->sequence, FUTEX_WAIT, sequence, 
+				(wait_ms < 0) ? nullptr : &timeout, nullptr, 0);
+	}
+	if (waiters)
+		waiters->waiters.fetch_sub(1, std::memory_order_seq_cst);
+#else
+	(void)timeout_ms;
+#endif
+	return segment->sequence.load(std::memory_order_acquire) != sequence;
+}
+
+//-------------------------------events------------------------------
+
+// the cursor for reading only the events published from now on
+uint64_t CalcStateReader::event_cursor() const {
+	return segment ? segment->event_count.load(std::memory_order_acquire) : 0;
+}
+
+// copies up to max_count events published after cursor into events and
+// moves cursor past them, returns how many were copied
+// the calculator may overwrite a slot while it is read, so each slot holds
+// its event number and one that doesn't match the cursor counts as lost
+int CalcStateReader::read_events(uint64_t &cursor, char *events, 
+								 const int max_count, uint64_t &lost) const {
+	lost = 0;
+	if (!segment)
+		return 0;
+	const uint64_t count = segment->event_count.load(std::memory_order_acquire);
+	// a cursor from before the calculator restarted
+	if (cursor > count)
+		cursor = count;
+	if (count - cursor > uint64_t(CALC_SHM_EVENTS)) {
+		lost = count - CALC_SHM_EVENTS - cursor;
+		cursor = count - CALC_SHM_EVENTS;
+	}
+	int copied = 0;
+	for (; cursor < count && copied < max_count; ++cursor) {
+		const uint64_t slot = segment->events[cursor % CALC_SHM_EVENTS].load(
+			std::memory_order_acquire);
+		if (slot >> 8 == cursor)
+			events[copied++] = char(slot & 0xff);
+		else
+			++lost;
+	}
+	return copied;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "calcshm.h"
+#include <string>
+#include <vector>
+
+// reads the state a running calculator publishes, from another process
+// reading never blocks the calculator: a copy that overlaps a publish is
+// retried, and events are read from the ring without taking a lock
+// only works on Linux, open() fails elsewhere
+class CalcStateReader {
+public:
+	// unmaps the segment
+	~CalcStateReader();
+
+	// maps the segment name, from list_calc_segments() or from
+	// calc_shm_name() with the calculator's process id, returns false if no calculator has created it or it has a
+	// different layout version
+	bool open(const std::string &name);
+	void close();
+	bool is_open() const;
+	// true once the calculator has exited, a new calculator creates a new
+	// segment, so open() again to follow it
+	bool is_closed() const;
+
+	// changes with every publish, pass it to wait()
+	uint32_t sequence() const;
+	// copies the state published last, returns false if not open
+	bool read(CalcShmState &state) const;
+	// blocks until the sequence is no longer sequence, or timeout_ms passes,
+	// a negative timeout waits forever, returns whether the sequence changed
+	bool wait(const uint32_t sequence, const int timeout_ms) const;
+
+	// the cursor for reading only the events published from now on
+	uint64_t event_cursor() const;
+	// copies up to max_count events published after cursor into events and
+	// moves cursor past them, returns how many were copied
+	// events the ring overwrote before they could be read are skipped and
+	// counted in lost
+	int read_events(uint64_t &cursor, char *events, const int max_count,
+					uint64_t &lost) const;
+
+private:
+	// mapped read only
+	const CalcShmSegment *segment = nullptr;
+	// nullptr if this can't count itself as a waiter, then wait() polls
+	CalcShmWaiters *waiters = nullptr;
+};
+
+// the names of the state segments of running calculators, to pass to
+// CalcStateReader::open(), empty if there are none or not on Linux
+std::vector<std::string> list_calc_segments();
@@ -0,0 +1,14 @@
+# a static library for reading the state the calculator publishes in
+# shared memory, for other processes such as loggers and screen readers
+TEMPLATE = lib
+CONFIG += staticlib c++17
+CONFIG -= qt
+TARGET = calcshmreader
+
+INCLUDEPATH += ..
+SOURCES += calcshmreader.cpp
+HEADERS += calcshmreader.h ../calcshm.h
+linux: LIBS += -lrt
+
+OBJECTS_DIR = build
+DESTDIR = build
@@ -0,0 +1,147 @@
+#include "stateexport.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------setup------------------------------
+
+#ifdef __linux__
+// removes the segments left by calculators that crashed, found by their
+// process id no longer running, segments of running calculators are kept
+// Linux keeps shared memory in /dev/shm, so the names can be listed there
+static void remove_stale_segments() {
+	DIR *dir = opendir("/dev/shm");
+	if (!dir)
+		return;
+	while (dirent *entry = readdir(dir)) {
+		const long pid = calc_shm_pid(entry->d_name);
+		if (pid != 0 && kill(pid, 0) == -1 && errno == ESRCH)
+			shm_unlink(("/" + std::string(entry->d_name)).c_str());
+	}
+	closedir(dir);
+}
+
+// creates and maps a zero filled segment of size bytes, nullptr if it can't
+// the name has this process's id, so a segment already using it was left
+// by a calculator that crashed with the same id, and is replaced
+static void *create_segment(const std::string &name, const size_t size, 
+							const mode_t mode) {
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+	if (fd == -1 && errno == EEXIST) {
+		shm_unlink(name.c_str());
+		fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+	}
+	if (fd == -1)
+		return nullptr;
+	// shm_open() applies the umask
+	fchmod(fd, mode);
+	void *memory = MAP_FAILED;
+	if (ftruncate(fd, size) == 0) {
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+					  fd, 0);
+	}
+	close(fd);
+	if (memory == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+	return memory;
+}
+#endif
+
+// creates the segments, name should come from calc_shm_name()
+// the state can be read by the same user or group, who can also count
+// themselves as waiters, but nobody else can change the state
+StateExport::StateExport(const std::string &name_in) 
+: name(name_in), waiters_name(name_in + CALC_SHM_WAITERS_SUFFIX) {
+#ifdef __linux__
+	static const bool removed_stale = (remove_stale_segments(), true);
+	(void)removed_stale;
+	void *memory = create_segment(name, sizeof(CalcShmSegment), 0640);
+	if (!memory)
+		return;
+	void *waiters_memory = create_segment(waiters_name, 
+										  sizeof(CalcShmWaiters), 0660);
+	if (!waiters_memory) {
+		munmap(memory, sizeof(CalcShmSegment));
+		shm_unlink(name.c_str());
+		return;
+	}
+	segment = static_cast<CalcShmSegment *>(memory);
+	waiters = static_cast<CalcShmWaiters *>(waiters_memory);
+	segment->version = CALC_SHM_VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	segment->magic = CALC_SHM_MAGIC;
+#endif
+}
+
+// unmaps and removes the segments this created, readers keep their mappings
+// waiting readers are woken to see that it is closed
+StateExport::~StateExport() {
+#ifdef __linux__
+	if (!segment)
+		return;
+	segment->closed.store(1, std::memory_order_release);
+	segment->sequence.fetch_add(2, std::memory_order_seq_cst);
+	syscall(SYS_futex, &segment->sequence, FUTEX_WAKE, INT_MAX, 
+			nullptr, nullptr, 0);
+	munmap(segment, sizeof(CalcShmSegment));
+	munmap(waiters, sizeof(CalcShmWaiters));
+	shm_unlink(name.c_str());
+	shm_unlink(waiters_name.c_str());
+#endif
+}
+
+bool StateExport::is_open() const {
+	return segment != nullptr;
+}
+
+//------------------------------publish------------------------------
+
+// copies state into the segment, adds event to the ring unless it is
+// '\0', then wakes any waiting readers
+// the state is written between two increments of the sequence, readers
+// copy it and retry if the sequence was odd or changed meanwhile
+void StateExport::publish(const CalcShmState &state, const char event) {
+#ifdef __linux__
+	if (!segment)
+		return;
+	const uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+	segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(&segment->state, &state, sizeof(state));
+	
+	if (event != '\0') {
+		// the slot is written before the count, so a reader that sees the
+		// count sees the slot or a newer event that replaced it
+		const uint64_t count = segment->event_count.load(std::memory_order_relaxed);
+		segment->events[count % CALC_SHM_EVENTS].store(
+			count << 8 | static_cast<unsigned char>(event), 
+			std::memory_order_release);
+		segment->event_count.store(count + 1, std::memory_order_release);
+	}
+	
+	// a reader adds itself to waiters before checking the sequence, so
+	// either it sees the new sequence or this sees it waiting
+	segment->sequence.store(sequence + 2, std::memory_order_seq_cst);
+	if (waiters->waiters.load(std::memory_order_seq_cst) > 0) {
+		syscall(SYS_futex, &segment->sequence, FUTEX_WAKE, INT_MAX, 
+				nullptr, nullptr, 0);
+	}
+#else
+	(void)state;
+	(void)event;
+#endif
+}
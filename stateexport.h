@@ -0,0 +1,30 @@
+#pragma once
+
+#include "calcshm.h"
+#include <string>
+
+// publishes the calculator's state to other processes in the shared memory
+// segment described in calcshm.h
+// publishing copies a few hundred bytes and only makes a system call when a
+// reader is waiting, so it is cheap enough to do after every event
+// does nothing if the segment can't be created, or off Linux, where the
+// futex the readers wait on isn't available
+class StateExport {
+public:
+	// creates the segments, name should come from calc_shm_name()
+	StateExport(const std::string &name_in);
+	// unmaps and removes the segments this created, readers keep their
+	// mappings
+	~StateExport();
+
+	bool is_open() const;
+	// copies state into the segment, adds event to the ring unless it is
+	// '\0', then wakes any waiting readers
+	void publish(const CalcShmState &state, const char event);
+
+private:
+	std::string name;
+	std::string waiters_name;
+	CalcShmSegment *segment = nullptr;
+	CalcShmWaiters *waiters = nullptr;
+};
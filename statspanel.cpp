@@ -0,0 +1,192 @@
+#include "statspanel.h"
+#include "calculator.h"
+
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QGuiApplication>
+#include <QClipboard>
+
+#include <cmath>
+
+// makes a selectable, right aligned value label
+static QLabel *new_value_label(QWidget *parent) {
+	QLabel *label = new QLabel(parent);
+	label->setAlignment(Qt::AlignRight);
+	label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	label->setMinimumWidth(120);
+	return label;
+}
+
+//----------------------------constructor----------------------------
+
+// builds the labels and buttons, calc is used for number formatting
+StatsPanel::StatsPanel(Calculator *calc_in)
+: QWidget(calc_in, Qt::Tool), calc(calc_in) {
+	setWindowTitle("statistics");
+	
+	QFormLayout *values = new QFormLayout;
+	values->addRow("n", count_label = new_value_label(this));
+	values->addRow("Σ", sum_label = new_value_label(this));
+	values->addRow("mean", mean_label = new_value_label(this));
+	values->addRow("std dev", std_dev_label = new_value_label(this));
+	values->addRow("variance", variance_label = new_value_label(this));
+	values->addRow("min", min_label = new_value_label(this));
+	values->addRow("q1", q1_label = new_value_label(this));
+	values->addRow("median", median_label = new_value_label(this));
+	values->addRow("q3", q3_label = new_value_label(this));
+	values->addRow("max", max_label = new_value_label(this));
+	status_label = new QLabel(this);
+	
+	load_button = new QPushButton("load file", this);
+	paste_button = new QPushButton("paste", this);
+	clear_button = new QPushButton("clear", this);
+	connect(load_button, SIGNAL(clicked()), this, SLOT(load_file()));
+	connect(paste_button, SIGNAL(clicked()), this, SLOT(paste_column()));
+	connect(clear_button, SIGNAL(clicked()), this, SLOT(clear()));
+	// keep key presses going to the calculator
+	load_button->setFocusPolicy(Qt::NoFocus);
+	paste_button->setFocusPolicy(Qt::NoFocus);
+	clear_button->setFocusPolicy(Qt::NoFocus);
+	
+	QHBoxLayout *buttons = new QHBoxLayout;
+	buttons->addWidget(load_button);
+	buttons->addWidget(paste_button);
+	buttons->addWidget(clear_button);
+	
+	QVBoxLayout *vbox = new QVBoxLayout;
+	vbox->addLayout(values);
+	vbox->addWidget(status_label);
+	vbox->addLayout(buttons);
+	setLayout(vbox);
+	
+	load_timer = new QTimer(this);
+	load_timer->setInterval(16);
+	connect(load_timer, SIGNAL(timeout()), this, SLOT(poll_load()));
+	
+	update_labels();
+}
+
+// waits for a running load
+StatsPanel::~StatsPanel() {
+	if (load_thread.joinable())
+		load_thread.join();
+}
+
+//------------------------------inputs-------------------------------
+
+// adds a single value and updates the labels
+void StatsPanel::add_value(const double value) {
+	stats.add(value);
+	update_labels();
+}
+
+// memory maps a file with one number per line and reduces it in parallel
+void StatsPanel::load_file() {
+	QString path = QFileDialog::getOpenFileName(this, "load data");
+	if (path.isEmpty())
+		return;
+	load_source.setFileName(path);
+	if (!load_source.open(QIODevice::ReadOnly)) {
+		status_label->setText("file error");
+		return;
+	}
+	if (load_source.size() == 0) {
+		load_source.close();
+		add_column(ColumnStats());
+		return;
+	}
+	const char *data = reinterpret_cast<const char *>(
+		load_source.map(0, load_source.size()));
+	if (!data) {
+		load_source.close();
+		status_label->setText("file map error");
+		return;
+	}
+	start_load(data, data + load_source.size());
+}
+
+// reduces a column of numbers pasted from the clipboard
+void StatsPanel::paste_column() {
+	load_text = QGuiApplication::clipboard()->text().toUtf8();
+	start_load(load_text.constData(), 
+			   load_text.constData() + load_text.size());
+}
+
+// empties the data set
+void StatsPanel::clear() {
+	stats = StreamStats();
+	bad_lines = 0;
+	update_labels();
+}
+
+// reduces the text from begin to end on load_thread
+void StatsPanel::start_load(const char *begin, const char *end) {
+	load_button->setEnabled(false);
+	paste_button->setEnabled(false);
+	clear_button->setEnabled(false);
+	status_label->setText("loading");
+	load_done = false;
+	load_thread = std::thread([this, begin, end] {
+		loaded = reduce_column(begin, end);
+		load_done.store(true, std::memory_order_release);
+	});
+	load_timer->start();
+}
+
+// called by load_timer, adds the column once the load is done
+void StatsPanel::poll_load() {
+	if (!load_done.load(std::memory_order_acquire))
+		return;
+	load_thread.join();
+	load_timer->stop();
+	load_source.close();
+	load_text.clear();
+	load_button->setEnabled(true);
+	paste_button->setEnabled(true);
+	clear_button->setEnabled(true);
+	add_column(loaded);
+}
+
+// merges a reduced column into stats
+void StatsPanel::add_column(const ColumnStats &column) {
+	stats.merge(column.stats);
+	bad_lines += column.bad_lines;
+	update_labels();
+}
+
+//------------------------------display------------------------------
+
+// rewrites all labels from stats
+void StatsPanel::update_labels() {
+	count_label->setText(QString::number(stats.count()));
+	sum_label->setText(format(stats.sum(), "no data error"));
+	mean_label->setText(format(stats.mean(), "no data error"));
+	std_dev_label->setText(format(stats.std_dev(), "sample size error"));
+	variance_label->setText(format(stats.variance(), "sample size error"));
+	min_label->setText(format(stats.min(), "no data error"));
+	q1_label->setText(format(stats.quantile(0.25), "no data error"));
+	median_label->setText(format(stats.quantile(0.5), "no data error"));
+	q3_label->setText(format(stats.quantile(0.75), "no data error"));
+	max_label->setText(format(stats.max(), "no data error"));
+	if (bad_lines == 0)
+		status_label->clear();
+	else
+		status_label->setText(QString("skipped %1 lines").arg(bad_lines));
+}
+
+// formats value like the calculator displays, or returns an error message
+// nan means the statistic is undefined for the current data set
+QString StatsPanel::format(const double value, const char *undefined_error) {
+	if (std::isnan(value))
+		return undefined_error;
+	QString str = calc->double_to_string(value);
+	try {
+		calc->check_number_error(str);
+	}
+	catch (const QString &error_message) {
+		return error_message;
+	}
+	return str;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "calcstats.h"
+#include <QWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QFile>
+#include <QTimer>
+#include <atomic>
+#include <thread>
+
+class Calculator;
+
+// a tool window showing streaming statistics of a data set
+// values come from the calculator's active display, a file, or the clipboard
+class StatsPanel : public QWidget {
+	Q_OBJECT
+
+public:
+	// builds the labels and buttons, calc is used for number formatting
+	StatsPanel(Calculator *calc_in);
+	// waits for a running load
+	~StatsPanel();
+
+	// adds a single value and updates the labels
+	void add_value(const double value);
+
+private slots:
+	// memory maps a file with one number per line and reduces it in parallel
+	void load_file();
+	// reduces a column of numbers pasted from the clipboard
+	void paste_column();
+	// empties the data set
+	void clear();
+	// called by load_timer, adds the column once the load is done
+	void poll_load();
+
+private:
+	Calculator *calc;
+	StreamStats stats;
+	long long bad_lines = 0;
+
+	QLabel *count_label;
+	QLabel *sum_label;
+	QLabel *mean_label;
+	QLabel *std_dev_label;
+	QLabel *variance_label;
+	QLabel *min_label;
+	QLabel *q1_label;
+	QLabel *median_label;
+	QLabel *q3_label;
+	QLabel *max_label;
+	// shows skipped lines and file errors
+	QLabel *status_label;
+	// disabled while loading
+	QPushButton *load_button;
+	QPushButton *paste_button;
+	QPushButton *clear_button;
+
+	// files and pastes are reduced on load_thread, so the window keeps
+	// responding to big loads
+	std::thread load_thread;
+	// set by load_thread once loaded is written
+	std::atomic<bool> load_done{false};
+	ColumnStats loaded;
+	// the mapped file or the pasted text, kept until the load is done
+	QFile load_source;
+	QByteArray load_text;
+	// polls the load about once a frame
+	QTimer *load_timer;
+
+	// reduces the text from begin to end on load_thread
+	void start_load(const char *begin, const char *end);
+	// merges a reduced column into stats
+	void add_column(const ColumnStats &column);
+	// rewrites all labels from stats
+	void update_labels();
+	// formats value like the calculator displays, or returns an error message
+	QString format(const double value, const char *undefined_error);
+};
@@ -0,0 +1,156 @@
+// counts the heap allocations made while the calculator handles steady
+// state keystrokes, digits, the sign, binary ops and equals, and fails if
+// any are made other than by the amortized growth of the event frames
+// operator new is replaced, and on glibc so is malloc, which Qt's
+// containers allocate with directly
+// the calculator is never shown, so update() returns early and the repaint
+// scheduling Qt does for a visible window isn't covered
+#include "calculator.h"
+#include <QApplication>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool> counting{false};
+static std::atomic<long long> allocations{0};
+
+static void count_allocation() {
+	if (counting.load(std::memory_order_relaxed))
+		allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------allocator hooks------------------------
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) {
+	count_allocation();
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	count_allocation();
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+	count_allocation();
+	return __libc_realloc(pointer, size);
+}
+}
+
+// counted by malloc
+static void *allocate(const size_t size) {
+	return std::malloc(size ? size : 1);
+}
+#else
+static void *allocate(const size_t size) {
+	count_allocation();
+	return std::malloc(size ? size : 1);
+}
+#endif
+
+void *operator new(size_t size) {
+	if (void *pointer = allocate(size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+//--------------------------------test-------------------------------
+
+// every event of these is allowed where it is, a rejected one would throw,
+// and throwing allocates the exception
+static const char *const KEYS[] = {
+	"12.5s+7.25q", "3x4.5sq", "96d3q", "8-2.75q", "0.125+1.5sxq"
+};
+// each key string ends in one equals, which adds a frame
+static const int KEYS_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+static const int WARMUP_ROUNDS = 2;
+// enough frames to outgrow the 64 the calculator reserves several times
+static const int COUNTED_ROUNDS = 60;
+// the frames are reserved this many at a time, or grow geometrically from
+// it, so an event only allocates once this many frames have been added
+static const int FRAME_CHUNK = 64;
+
+int main(int argc, char **argv) {
+	// the calculator is never shown, so no window system is needed
+	qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+	Calculator calc;
+	
+	// the first rounds fill the glyph caches and touch everything once
+	for (int round = 0; round < WARMUP_ROUNDS; ++round) {
+		for (const char *keys : KEYS) {
+			for (const char *key = keys; *key != '\0'; ++key)
+				calc.do_event(*key, true);
+		}
+	}
+	
+	long long total = 0;
+	int events = 0;
+	int allocating_events = 0;
+	for (int round = 0; round < COUNTED_ROUNDS; ++round) {
+		for (const char *keys : KEYS) {
+			for (const char *key = keys; *key != '\0'; ++key) {
+				allocations.store(0);
+				counting.store(true);
+				calc.do_event(*key, true);
+				counting.store(false);
+				++events;
+				if (allocations.load() > 0) {
+					std::printf("'%c' in \"%s\" allocated %lld times\n", 
+								*key, keys, allocations.load());
+					total += allocations.load();
+					++allocating_events;
+				}
+			}
+		}
+	}
+	// each growth of the frames, or of the events they share, is one event
+	// allocating, for both at most once per FRAME_CHUNK frames added
+	const int frames_added = COUNTED_ROUNDS * KEYS_COUNT;
+	const int growth_limit = 2 * (frames_added / FRAME_CHUNK + 1);
+	if (allocating_events > growth_limit) {
+		std::printf("FAIL: %d events allocated %lld times, growing the "
+					"frames allows %d\n", allocating_events, total, 
+					growth_limit);
+		return 1;
+	}
+	std::printf("PASS: %d of %d events allocated, within the %d growing the "
+				"frames allows\n", allocating_events, events, growth_limit);
+	return 0;
+}
@@ -0,0 +1,15 @@
+# fails if the steady state keystroke path allocates other than to grow the
+# event frames, run with make check
+TEMPLATE = app
+TARGET = alloctest
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../calculator.pri)
+# the debug output allocates, and isn't part of the keystroke path
+DEFINES -= CALC_DEBUG
+SOURCES += alloctest.cpp
+
+MOC_DIR = build
+OBJECTS_DIR = build
+DESTDIR = build
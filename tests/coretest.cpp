@@ -0,0 +1,160 @@
+// checks the calculator's rules give the expected displays at runtime, and
+// with GCC that the exact compile time conversions and ops in calccore.h
+// give the same results as the library ones used at runtime
+#include "calccore.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+struct KeysCase {
+	const char *keys;
+	const char16_t *upper;
+};
+
+// keystrokes and the upper display they leave
+static const KeysCase KEYS_CASES[] = {
+	{ "2+3q", u"5" },
+	{ "1m.1q", u"0" },
+	{ ".1+.2q", u"0.3" },
+	{ "2^.5q", u"1.414213562" },
+	{ "5d0q", u"divide by 0 error" },
+	{ "1e300x1e300q", u"max size error" },
+	{ "7d3q", u"2.333333333" },
+	{ "10l1000q", u"3" },
+	{ "9ri", u"0.3333333333" },
+	{ "4!", u"24" },
+	{ "1e5sx3q", u"3e-05" },
+	{ "123456789x1000q", u"1.23456789e+11" },
+	{ "2sx3qq", u"-18" },
+	// redone from the exact decimals
+	{ "1.000000001-1q", u"1e-09" },
+	{ "1.000000001l1.000000002q", u"1.999999999" }
+};
+
+// numbers for the conversions, including halfway and subnormal cases
+constexpr double VALUES[] = {
+	0.0, -0.0, 1.0, -1.5, 0.1, 0.3, 1.0 / 3, 2.0 / 3, 12345.678901234,
+	123456789012.0, 9999999999.5, 0.00012345, 0.000012345, 1e-300, 4.9e-324,
+	1.7976931348623157e308, -2.5e-7, 3.14159265358979, 1e22, 1e23, 1.25e-5,
+	6.02214076e23, 299792458.0, 1.0000000005, 0.99999999995
+};
+constexpr int VALUE_COUNT = sizeof(VALUES) / sizeof(VALUES[0]);
+
+struct BinaryCase {
+	char op;
+	double up;
+	double lo;
+};
+
+// ops with results exact at both, or beyond the range of a double
+constexpr BinaryCase BINARY_CASES[] = {
+	{ '+', 0.1, 0.2 }, { '-', 1e308, -1e308 }, { 'x', 1e200, 1e200 },
+	{ 'x', 1e-200, 1e-200 }, { 'd', 1, 3 }, { 'd', 1e300, 1e-300 },
+	{ '^', 2, 10 }, { '^', 10, -320 }, { '^', 0, -1 }, { '^', 1e10, 40 },
+	{ 'l', 2, 1024 }, { 'l', 1, 5 }, { 'm', 7.5, 2 }, { 'm', -7.5, 2 }
+};
+constexpr int BINARY_COUNT = sizeof(BINARY_CASES) / sizeof(BINARY_CASES[0]);
+
+static int failures = 0;
+
+static std::string to_utf8(const DisplayText &text) {
+	std::string str;
+	for (int i = 0; i < text.size(); ++i)
+		str += char(text[i]);
+	return str;
+}
+
+static void check(const bool ok, const std::string &what,
+				  const DisplayText &runtime, const DisplayText &expected) {
+	if (ok)
+		return;
+	std::printf("%s: \"%s\" at runtime, expected \"%s\"\n", what.c_str(),
+				to_utf8(runtime).c_str(), to_utf8(expected).c_str());
+	++failures;
+}
+
+//---------------------------compile time results--------------------
+
+#if defined(__GNUC__) && !defined(__clang__)
+struct CompiledResults {
+	CalcState keys[sizeof(KEYS_CASES) / sizeof(KEYS_CASES[0])];
+	DisplayText formatted[VALUE_COUNT];
+	double parsed[VALUE_COUNT] = {};
+	DisplayText binary[BINARY_COUNT];
+};
+
+// KEYS_CASES isn't constexpr, its strings are repeated here
+constexpr const char *COMPILED_KEYS[] = {
+	"2+3q", "1m.1q", ".1+.2q", "2^.5q", "5d0q", "1e300x1e300q", "7d3q",
+	"10l1000q", "9ri", "4!", "1e5sx3q", "123456789x1000q", "2sx3qq",
+	"1.000000001-1q", "1.000000001l1.000000002q"
+};
+
+constexpr CompiledResults compile_results() {
+	CompiledResults results;
+	for (int i = 0; i < int(sizeof(COMPILED_KEYS) / sizeof(char *)); ++i)
+		results.keys[i] = evaluate_keys(COMPILED_KEYS[i]);
+	for (int i = 0; i < VALUE_COUNT; ++i) {
+		results.formatted[i] = format_number(VALUES[i]);
+		results.parsed[i] = parse_number(results.formatted[i]);
+	}
+	for (int i = 0; i < BINARY_COUNT; ++i) {
+		const BinaryCase &c = BINARY_CASES[i];
+		results.binary[i] = format_number(calculate_binary(c.op, c.up, c.lo));
+	}
+	return results;
+}
+
+constexpr CompiledResults COMPILED = compile_results();
+
+// compares the runtime results to the compile time ones
+static void check_compiled() {
+	for (int i = 0; i < int(sizeof(COMPILED_KEYS) / sizeof(char *)); ++i) {
+		CalcState state = evaluate_keys(COMPILED_KEYS[i]);
+		check(state.upper == COMPILED.keys[i].upper
+			  && state.lower == COMPILED.keys[i].lower,
+			  std::string("compiled keys ") + COMPILED_KEYS[i], state.upper,
+			  COMPILED.keys[i].upper);
+	}
+	for (int i = 0; i < VALUE_COUNT; ++i) {
+		DisplayText formatted = format_number(VALUES[i]);
+		check(formatted == COMPILED.formatted[i],
+			  "format_number " + std::to_string(i), formatted,
+			  COMPILED.formatted[i]);
+		double parsed = parse_number(formatted);
+		check(std::memcmp(&parsed, &COMPILED.parsed[i], sizeof(double)) == 0,
+			  "parse_number " + to_utf8(formatted), format_number(parsed),
+			  format_number(COMPILED.parsed[i]));
+	}
+	for (int i = 0; i < BINARY_COUNT; ++i) {
+		const BinaryCase &c = BINARY_CASES[i];
+		DisplayText result = format_number(calculate_binary(c.op, c.up, c.lo));
+		check(result == COMPILED.binary[i],
+			  std::string("calculate_binary ") + c.op + " " + std::to_string(i),
+			  result, COMPILED.binary[i]);
+	}
+}
+#endif
+
+//--------------------------------main-------------------------------
+
+int main() {
+	for (const KeysCase &c : KEYS_CASES) {
+		DisplayText expected;
+		for (const char16_t *ch = c.upper; *ch != u'\0'; ++ch)
+			expected.append(*ch);
+		DisplayText upper = evaluate_keys(c.keys).upper;
+		check(upper == expected, std::string("keys ") + c.keys, upper,
+			  expected);
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+	check_compiled();
+#endif
+	if (failures > 0) {
+		std::printf("FAIL: %d mismatches\n", failures);
+		return 1;
+	}
+	std::printf("PASS: runtime and compile time results agree\n");
+	return 0;
+}
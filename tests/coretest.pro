@@ -0,0 +1,15 @@
+# checks the runtime and compile time paths of calccore.h agree, run with
+# make check
+TEMPLATE = app
+TARGET = coretest
+QT = core
+CONFIG += console testcase c++17
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+HEADERS += ../calccore.h ../displaytext.h
+SOURCES += coretest.cpp
+
+MOC_DIR = build
+OBJECTS_DIR = build
+DESTDIR = build
@@ -0,0 +1,243 @@
+// publishes generations of the calculator state as fast as it can while
+// reader threads, and reader processes, copy it through the seqlock
+// every generation fills the whole state from its number, so a copy that
+// mixes two publishes is found by rebuilding the state from the number it
+// holds, readers also check the generations only move forward, and follow
+// the event ring checking each event is the one published with that number
+// only runs on Linux, like the segment itself
+#include "calcshmreader.h"
+#include "stateexport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int READER_THREADS = 8;
+static const int READER_PROCESSES = 2;
+static const uint32_t DEFAULT_PUBLISHES = 2000000;
+
+//----------------------------generations----------------------------
+
+// the state published as generation
+static CalcShmState make_state(const uint32_t generation) {
+	CalcShmState state;
+	std::memset(&state, 0, sizeof(state));
+	CalcShmText *texts[] = {
+		&state.upper, &state.lower, &state.memory1, &state.memory2
+	};
+	for (int t = 0; t < 4; ++t) {
+		texts[t]->length = (generation + t) % (CALC_SHM_TEXT_LENGTH + 1);
+		for (int i = 0; i < CALC_SHM_TEXT_LENGTH; ++i)
+			texts[t]->chars[i] = char16_t(generation * (t + 1) + i);
+	}
+	// the number itself, so a reader can rebuild what it should have read
+	state.upper.chars[0] = char16_t(generation);
+	state.upper.chars[1] = char16_t(generation >> 16);
+	state.binary_op = char(generation);
+	state.has_error = generation % 3 == 0;
+	state.rpn_mode = generation % 5 == 0;
+	state.task_running = generation % 7 == 0;
+	return state;
+}
+
+static uint32_t generation_of(const CalcShmState &state) {
+	return uint32_t(state.upper.chars[0]) | uint32_t(state.upper.chars[1]) << 16;
+}
+
+// the event published with event number n
+static char event_of(const uint64_t n) {
+	return char('!' + n % 90);
+}
+
+//------------------------------readers------------------------------
+
+struct ReaderResult {
+	uint64_t reads = 0;
+	uint64_t torn = 0;
+	uint64_t backwards = 0;
+	uint64_t events = 0;
+	uint64_t wrong_events = 0;
+	uint64_t lost_events = 0;
+};
+
+// reads until the segment closes, checking every copy and every event
+static void run_reader(const std::string &name, ReaderResult &result) {
+	CalcStateReader reader;
+	if (!reader.open(name)) {
+		++result.torn;
+		return;
+	}
+	CalcShmState state;
+	uint32_t last_generation = 0;
+	uint64_t cursor = reader.event_cursor();
+	char events[64];
+	while (!reader.is_closed()) {
+		reader.read(state);
+		const uint32_t generation = generation_of(state);
+		const CalcShmState expected = make_state(generation);
+		if (std::memcmp(&state, &expected, sizeof(state)) != 0)
+			++result.torn;
+		else if (generation < last_generation)
+			++result.backwards;
+		else
+			last_generation = generation;
+		++result.reads;
+
+		uint64_t lost = 0;
+		const uint64_t first = cursor;
+		const int count = reader.read_events(cursor, events, 64, lost);
+		result.lost_events += lost;
+		// lost events are skipped over, but where in the batch is unknown,
+		// so only batches without any are checked
+		for (int i = 0; i < count; ++i) {
+			if (lost == 0 && events[i] != event_of(first + i))
+				++result.wrong_events;
+		}
+		result.events += count;
+	}
+}
+
+// waits for publishes until the segment closes, counting the wake ups
+static void run_waiter(const std::string &name, uint64_t &wakes) {
+	CalcStateReader reader;
+	if (!reader.open(name))
+		return;
+	while (!reader.is_closed()) {
+		if (reader.wait(reader.sequence(), 100))
+			++wakes;
+	}
+}
+
+//--------------------------------main-------------------------------
+
+static bool check(const bool ok, const char *what) {
+	if (!ok)
+		std::printf("FAIL: %s\n", what);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	const uint32_t publishes = (argc > 1) ? uint32_t(std::atol(argv[1]))
+							   : DEFAULT_PUBLISHES;
+	const std::string name = calc_shm_name(getpid(), 1000);
+	bool ok = true;
+
+	// a second calculator's segments don't take over or remove these
+	StateExport *writer = new StateExport(name);
+	if (!check(writer->is_open(), "the segment can't be created"))
+		return 1;
+	{
+		const std::string other_name = calc_shm_name(getpid(), 1001);
+		StateExport other(other_name);
+		ok &= check(other.is_open(), "a second segment can't be created");
+		const std::vector<std::string> listed = list_calc_segments();
+		auto is_listed = [&listed](const std::string &listed_name) {
+			return std::count(listed.begin(), listed.end(), listed_name) == 1;
+		};
+		ok &= check(is_listed(name) && is_listed(other_name), 
+					"a segment isn't listed");
+		ok &= check(!is_listed(name + CALC_SHM_WAITERS_SUFFIX), 
+					"a waiters segment is listed");
+	}
+	CalcStateReader probe;
+	ok &= check(probe.open(name), "removing another segment removed this");
+	probe.close();
+	writer->publish(make_state(0), '\0');
+
+	// reader processes, with the results in memory shared with this one
+	void *shared = mmap(nullptr, READER_PROCESSES * sizeof(ReaderResult), 
+						PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, 
+						-1, 0);
+	if (!check(shared != MAP_FAILED, "no memory for the process results"))
+		return 1;
+	ReaderResult *process_results = new (shared) ReaderResult[READER_PROCESSES];
+	std::vector<pid_t> children;
+	for (int p = 0; p < READER_PROCESSES; ++p) {
+		const pid_t child = fork();
+		if (child == 0) {
+			run_reader(name, process_results[p]);
+			_exit(0);
+		}
+		children.push_back(child);
+	}
+	std::vector<ReaderResult> thread_results(READER_THREADS);
+	std::vector<std::thread> threads;
+	for (ReaderResult &result : thread_results)
+		threads.emplace_back(run_reader, name, std::ref(result));
+	uint64_t wakes = 0;
+	threads.emplace_back(run_waiter, name, std::ref(wakes));
+	// gives the readers time to open the segment
+	usleep(100000);
+
+	uint64_t event_count = 0;
+	for (uint32_t generation = 1; generation <= publishes; ++generation) {
+		// every other publish has an event, like displays updating twice
+		const bool has_event = generation % 2 == 0;
+		writer->publish(make_state(generation), 
+						has_event ? event_of(event_count) : '\0');
+		event_count += has_event;
+	}
+
+	// a reader blocked in wait() wakes on the next publish
+	{
+		CalcStateReader reader;
+		reader.open(name);
+		const uint32_t sequence = reader.sequence();
+		std::atomic<bool> woken{false};
+		std::thread waiter([&] {
+			woken = reader.wait(sequence, 5000);
+		});
+		usleep(50000);
+		writer->publish(make_state(publishes), '\0');
+		waiter.join();
+		ok &= check(woken, "a blocked waiter wasn't woken");
+	}
+
+	// closing wakes and stops everything still reading
+	delete writer;
+	for (std::thread &thread : threads)
+		thread.join();
+	for (const pid_t child : children)
+		waitpid(child, nullptr, 0);
+	CalcStateReader closed;
+	ok &= check(!closed.open(name), "the segment is left after closing");
+	const std::vector<std::string> listed = list_calc_segments();
+	ok &= check(std::count(listed.begin(), listed.end(), name) == 0, 
+				"a closed segment is listed");
+
+	ReaderResult total;
+	std::vector<ReaderResult> results(thread_results);
+	results.insert(results.end(), process_results, 
+				   process_results + READER_PROCESSES);
+	for (const ReaderResult &result : results) {
+		ok &= check(result.reads > 0, "a reader never read the state");
+		total.reads += result.reads;
+		total.torn += result.torn;
+		total.backwards += result.backwards;
+		total.events += result.events;
+		total.wrong_events += result.wrong_events;
+		total.lost_events += result.lost_events;
+	}
+	std::printf("%u publishes, %llu reads, %llu events read, %llu lost, "
+				"%llu wake ups\n", publishes, 
+				(unsigned long long)total.reads, 
+				(unsigned long long)total.events, 
+				(unsigned long long)total.lost_events, 
+				(unsigned long long)wakes);
+	ok &= check(total.torn == 0, "torn reads");
+	ok &= check(total.backwards == 0, "reads went back a generation");
+	ok &= check(total.wrong_events == 0, "wrong events");
+	ok &= check(wakes > 0, "the waiter was never woken");
+	if (!ok)
+		return 1;
+	std::printf("PASS: no torn reads or wrong events\n");
+	return 0;
+}
@@ -0,0 +1,14 @@
+# publishes the calculator state while many reader threads and processes
+# read it, failing on a torn read or a wrong event, run with make check
+TEMPLATE = app
+TARGET = shmstress
+CONFIG += console testcase c++17
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += .. ../shmreader
+HEADERS += ../calcshm.h ../stateexport.h ../shmreader/calcshmreader.h
+SOURCES += shmstress.cpp ../stateexport.cpp ../shmreader/calcshmreader.cpp
+LIBS += -lrt -lpthread
+
+OBJECTS_DIR = build
+DESTDIR = build